@@ -44,12 +44,16 @@ VENUS_SOURCE := \
 	$(THIS_PATH)/venus/Beauty.cpp          \
 	$(THIS_PATH)/venus/blend.cpp           \
 	$(THIS_PATH)/venus/blur.cpp            \
+	$(THIS_PATH)/venus/ColorCube.cpp       \
+	$(THIS_PATH)/venus/ColorPipeline.cpp   \
 	$(THIS_PATH)/venus/colorspace.cpp      \
+	$(THIS_PATH)/venus/Cosmetic.cpp        \
 	$(THIS_PATH)/venus/Effect.cpp          \
 	$(THIS_PATH)/venus/Feature.cpp         \
 	$(THIS_PATH)/venus/ImageWarp.cpp       \
 	$(THIS_PATH)/venus/inpaint.cpp         \
 	$(THIS_PATH)/venus/Makeup.cpp          \
+	$(THIS_PATH)/venus/MakeupLook.cpp      \
 	$(THIS_PATH)/venus/opencv_utility.cpp  \
 	$(THIS_PATH)/venus/Region.cpp          \
 
@@ -65,7 +69,7 @@ PLATFORM_SOURCE := \
 #$(addprefix $(THIS_PATH)/, $(RELATIVE_SOURCES))
 
 LOCAL_MODULE    := venus
-LOCAL_CPPFLAGS  := -DUSE_BGRA_LAYOUT=0 -DUSE_INPAINTING=0
+LOCAL_CPPFLAGS  := -DUSE_BGRA_LAYOUT=0
 LOCAL_SRC_FILES += $(STASM_SOURCE)
 LOCAL_SRC_FILES += $(VENUS_SOURCE) 
 LOCAL_SRC_FILES += $(PLATFORM_SOURCE)
@@ -1,3 +1,6 @@
+#include <iomanip>
+#include <iostream>
+
 #include <opencv2/highgui.hpp>
 
 #include "example/beauty.h"
@@ -176,4 +179,31 @@ void skinDermabrasion(const cv::Mat& image, const cv::Mat& mask)
 	onProgressChanged(level_max, &user_data);
 
 	cv::waitKey();
-}
\ No newline at end of file
+}
+
+void benchmarkSkinPreview(const cv::Mat& image)
+{
+	const Mat bgra = toBGRA(image);
+	const Mat mask = Beauty::calculateSkinRegion_RGB(bgra);
+
+	const float radius = 5.0F, level = 0.01F, whiten = 4.0F;
+	constexpr int LOOP = 5;
+
+	Mat expected;
+	const double full_time = timeMs([&]() { Beauty::retouchSkin(expected, bgra, mask, radius, level, whiten); }, LOOP);
+	std::cout << bgra.cols << 'x' << bgra.rows << std::fixed << std::setprecision(2)
+		<< "  full resolution " << full_time << "ms\n";
+
+	const int proxy_sizes[] = { 256, 512, 1024 };
+	for(const int proxy_size: proxy_sizes)
+	{
+		Mat preview;
+		const double time = timeMs([&]() {
+			Beauty::previewSkin(preview, bgra, mask, radius, level, whiten, proxy_size);
+		}, LOOP);
+
+		// pixels out of mask are untouched by both.
+		std::cout << "  proxy " << proxy_size << "  " << time << "ms  speedup " << full_time / time
+			<< "x  PSNR " << psnr(expected, preview, mask) << "dB\n";
+	}
+}
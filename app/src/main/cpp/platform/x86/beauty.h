@@ -14,4 +14,10 @@ void skinWhiten(const cv::Mat& image);
 void skinDermabrasion(const cv::Mat& image);
 void skinDermabrasion(const cv::Mat& image, const cv::Mat& mask);
 
+/**
+ * Time Beauty::retouchSkin() against Beauty::previewSkin() at a few proxy sizes, and print PSNR of the preview
+ * against the full resolution result over the skin mask.
+ */
+void benchmarkSkinPreview(const cv::Mat& image);
+
 #endif /* EXAMPLE_BEAUTY_H_ */
\ No newline at end of file
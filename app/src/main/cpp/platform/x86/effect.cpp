@@ -1,4 +1,13 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include "example/effect.h"
 #include "example/UserData.h"
@@ -8,6 +17,9 @@
 #include "venus/scalar.h"
 
 #include "venus/Beauty.h"
+#include "venus/ColorCube.h"
+#include "venus/ColorPipeline.h"
+#include "venus/blur.h"
 #include "venus/Effect.h"
 
 using namespace cv;
@@ -15,6 +27,82 @@ using namespace venus;
 
 static const std::string TAG("Effect");
 
+// brute force selective Gaussian blur over (2R+1)^2 neighbors, a reference of venus::gaussianBlurSelective().
+static void gaussianBlurSelectiveReference(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance)
+{
+	assert(src.depth() == CV_8U && mask.type() == CV_8UC1);
+	src.copyTo(dst);
+	const int R = cvRound(radius);
+	if(R <= 1)
+		return;
+
+	std::vector<float> kernel((2*R + 1) * (2*R + 1));
+	for(int y = -R; y <= R; ++y)
+	for(int x = -R; x <= R; ++x)
+		kernel[(y + R) * (2*R + 1) + (x + R)] = std::exp(-0.5F * (x*x + y*y) / radius);
+
+	const int N = src.channels(), M = std::min(N, 3);
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	for(int c = 0; c < src.cols; ++c)
+	{
+		if(mask.at<uint8_t>(r, c) == 0)
+			continue;
+
+		const uint8_t* center = src.ptr<uint8_t>(r) + c * N;
+		for(int m = 0; m < M; ++m)
+		{
+			float sum = 0.0F, weight = 0.0F;
+			for(int y = std::max(-R, -r); y <= std::min(R, src.rows - 1 - r); ++y)
+			for(int x = std::max(-R, -c); x <= std::min(R, src.cols - 1 - c); ++x)
+			{
+				const uint8_t around = src.ptr<uint8_t>(r + y)[(c + x) * N + m];
+				if(std::abs(around - center[m]) > tolerance)
+					continue;
+
+				const float w = kernel[(y + R) * (2*R + 1) + (x + R)];
+				sum += w * around;
+				weight += w;
+			}
+			dst.ptr<uint8_t>(r)[c * N + m] = saturate_cast<uint8_t>(sum / weight);
+		}
+	}
+}
+
+
+// average every block with cv::sum() on its ROI, a reference of Effect::pixelize().
+static void pixelizeReference(cv::Mat& dst, const cv::Mat& src, int width, int height)
+{
+	src.copyTo(dst);
+	for(int r = 0; r < src.rows; r += height)
+	for(int c = 0; c < src.cols; c += width)
+	{
+		const Rect rect(c, r, std::min(width, src.cols - c), std::min(height, src.rows - r));
+		dst(rect).setTo(cv::sum(src(rect)) / rect.area());
+	}
+}
+
+// float unsharp mask of the whole image, a reference of the in-place Effect::unsharpMask().
+static void unsharpMaskReference(cv::Mat& dst, const cv::Mat& src, float radius, int threshold, float amount, const cv::Mat& mask)
+{
+	Mat padded, blurred, image;
+	const int margin = 2 * cvRound(radius);
+	cv::copyMakeBorder(src, padded, margin, margin, margin, margin, BORDER_REPLICATE);
+	venus::gaussianBlur(blurred, padded, radius);
+	blurred = blurred(Rect(margin, margin, src.cols, src.rows));
+	src.convertTo(image, CV_32F);
+	blurred.convertTo(blurred, CV_32F);
+
+	Mat difference = image - blurred, weight;
+	mask.convertTo(weight, CV_32F, amount / 255.0);
+	cv::cvtColor(weight, weight, src.channels() == 4 ? COLOR_GRAY2BGRA : COLOR_GRAY2BGR);
+	Mat high_contrast = cv::abs(difference) > threshold;
+	high_contrast.convertTo(high_contrast, CV_32F, 1/255.0);
+	image += difference.mul(weight).mul(high_contrast);
+	image.convertTo(dst, CV_8U);
+	if(src.channels() == 4)
+		cv::mixChannels(src, dst, std::vector<int>{ 3, 3 });
+}
 
 void posterize(const cv::Mat& image)
 {
@@ -95,7 +183,7 @@ void selectiveGaussianBlur(const cv::Mat& image, const cv::Mat& mask)
 		UserData& data = *reinterpret_cast<UserData*>(user_data);
 		float radius = 7.0F;
 
-		Effect::gaussianBlurSelective(data.processed, data.original, data.mask, radius, threshold);
+		venus::gaussianBlurSelective(data.processed, data.original, data.mask, radius, threshold);
 		cv::imshow(data.title, data.processed);
 	};
 	
@@ -106,4 +194,226 @@ void selectiveGaussianBlur(const cv::Mat& image, const cv::Mat& mask)
 
 	onProgressChanged(threshold, &user_data);
 	cv::waitKey();
-}
\ No newline at end of file
+}
+
+void benchmarkGaussianBlur(const cv::Mat& image)
+{
+	const float sigmas[] = { 2.0F, 5.0F, 10.0F, 20.0F, 40.0F };
+	const int depths[] = { CV_8U, CV_32F };
+	constexpr int LOOP = 5;
+
+	for(const int depth: depths)
+	{
+		Mat src;
+		image.convertTo(src, depth, depth == CV_8U ? 1.0 : 1/255.0);
+		const double peak = depth == CV_8U ? 255.0 : 1.0;
+
+		std::cout << image.cols << 'x' << image.rows << (depth == CV_8U ? " CV_8U\n" : " CV_32F\n");
+		for(const float sigma: sigmas)
+		{
+			const int radius = static_cast<int>(std::ceil(sigma * 4));
+			Mat expected, blurred;
+
+			const double reference_time = timeMs([&]() {
+				cv::GaussianBlur(src, expected, Size(radius * 2 + 1, radius * 2 + 1), sigma, sigma, BORDER_CONSTANT);
+			}, LOOP);
+			const double time = timeMs([&]() { venus::recursiveGaussianBlur(blurred, src, sigma); }, LOOP);
+
+			const double max_error = cv::norm(expected, blurred, NORM_INF);
+			std::cout << std::fixed << std::setprecision(2) << "  sigma " << sigma
+				<< "  cv::GaussianBlur " << reference_time << "ms  recursive " << time
+				<< "ms  max error " << max_error / peak * 255 << "/255  PSNR " << psnr(expected, blurred) << "dB\n";
+		}
+	}
+}
+
+void benchmarkSelectiveBlur(const cv::Mat& image)
+{
+	const Mat bgra = toBGRA(image);
+	const Mat mask = Beauty::calculateSkinRegion_RGB(bgra);
+
+	const float radii[] = { 3.0F, 7.0F, 15.0F, 31.0F };
+	const float tolerances[] = { 12.0F, 32.0F };
+	constexpr int LOOP = 5;
+
+	std::cout << bgra.cols << 'x' << bgra.rows << " mask " << cv::countNonZero(mask) << " pixels\n";
+	for(const float radius: radii)
+	for(const float tolerance: tolerances)
+	{
+		Mat expected, blurred;
+		const double reference_time = timeMs([&]() {
+			gaussianBlurSelectiveReference(expected, bgra, mask, radius, tolerance);
+		});
+		const double time = timeMs([&]() { venus::gaussianBlurSelective(blurred, bgra, mask, radius, tolerance); }, LOOP);
+
+		// pixels out of mask are untouched by both.
+		std::cout << std::fixed << std::setprecision(2) << "  radius " << radius << " tolerance " << tolerance
+			<< "  brute force " << reference_time << "ms  bilateral grid " << time << "ms  max error "
+			<< cv::norm(expected, blurred, NORM_INF) << "  PSNR " << psnr(expected, blurred, mask) << "dB\n";
+	}
+}
+
+void benchmarkColorPipeline(const cv::Mat& image)
+{
+	const Mat bgra = toBGRA(image);
+	constexpr int LOOP = 10;
+
+	Mat expected;
+	const double chained_time = timeMs([&]() {
+		Effect::adjustBrightnessAndContrast(expected, bgra, 0.1F, 1.2F);
+		Effect::adjustGamma(expected, expected, 1.1F);
+		Effect::adjustGamma(expected, expected, Vec3f(0.9F, 1.0F, 1.1F));
+		Effect::tone(expected, expected, 0xFF3080C0, 0.2F);
+		Effect::posterize(expected, expected, 64.0F);
+	}, LOOP);
+
+	Mat actual;
+	const double time = timeMs([&]() {
+		ColorPipeline pipeline;
+		pipeline.adjustBrightnessAndContrast(0.1F, 1.2F).adjustGamma(1.1F).adjustGamma(Vec3f(0.9F, 1.0F, 1.1F))
+			.tone(0xFF3080C0, 0.2F).posterize(64.0F);
+		pipeline.apply(actual, bgra);
+	}, LOOP);
+
+	const bool exact = cv::norm(expected, actual, NORM_INF) == 0;
+	std::cout << bgra.cols << 'x' << bgra.rows << std::fixed << std::setprecision(2) << "  5 passes "
+		<< chained_time << "ms  pipeline " << time << "ms  speedup " << chained_time / time
+		<< (exact ? "x  exact\n" : "x  MISMATCH\n");
+}
+
+void benchmarkColorCube(const cv::Mat& image)
+{
+	const Mat bgra = toBGRA(image);
+	constexpr int LOOP = 5;
+
+	auto grade = [](cv::Mat& dst, const cv::Mat& src)
+	{
+		Mat adjusted;
+		Effect::adjustHueSaturation(adjusted, src, 0.05F, 1.3F, 0.05F);
+		Effect::adjustGamma(dst, adjusted, 1.2F);
+	};
+
+	Mat expected;
+	const double direct_time = timeMs([&]() { grade(expected, bgra); }, LOOP);
+	std::cout << bgra.cols << 'x' << bgra.rows << std::fixed << std::setprecision(2)
+		<< "  hue/saturation + gamma " << direct_time << "ms\n";
+
+	const int sizes[] = { 17, 33, 65 };
+	for(const int size: sizes)
+	{
+		ColorCube cube;
+		const double bake_time = timeMs([&]() {
+			cube = ColorCube::bake(size, [&grade](cv::Mat& image) { grade(image, image.clone()); });
+		});
+
+		Mat graded;
+		const double time = timeMs([&]() { cube.apply(graded, bgra); }, LOOP);
+
+		// a .cube round trip keeps 6 decimals, which is far below 8 bits precision.
+		std::stringstream stream;
+		ColorCube loaded(2);
+		Mat reloaded;
+		const bool round_trip = cube.save(stream) && loaded.load(stream);
+		if(round_trip)
+			loaded.apply(reloaded, bgra);
+
+		std::cout << "  cube " << size << "  bake " << bake_time << "ms  apply " << time
+			<< "ms  speedup " << direct_time / time << "x  max error " << cv::norm(expected, graded, NORM_INF)
+			<< "  PSNR " << psnr(expected, graded) << "dB  .cube round trip "
+			<< (round_trip && cv::norm(graded, reloaded, NORM_INF) <= 1 ? "ok\n" : "FAILED\n");
+	}
+}
+
+// Time @p adjust on an 8 bits image against its float version, including conversions which 8 bits callers used to pay.
+static void benchmark8U(const char* name, const cv::Mat& image, const std::function<void(cv::Mat&, const cv::Mat&)>& adjust)
+{
+	constexpr int LOOP = 5;
+	Mat expected, actual;
+	const double float_time = timeMs([&]() {
+		Mat src, dst;
+		image.convertTo(src, CV_32F, 1/255.0);
+		adjust(dst, src);
+		dst.convertTo(expected, CV_8U, 255.0);
+	}, LOOP);
+	const double time = timeMs([&]() { adjust(actual, image); }, LOOP);
+
+	std::cout << image.cols << 'x' << image.rows << std::fixed << std::setprecision(2) << "  " << name << " float "
+		<< float_time << "ms  8 bits " << time << "ms  speedup " << float_time / time << "x  max error "
+		<< cv::norm(expected, actual, NORM_INF) << '\n';
+}
+
+void benchmarkHueSaturation(const cv::Mat& image)
+{
+	const Mat bgra = toBGRA(image);
+	benchmark8U("adjustHueSaturation", bgra, [](cv::Mat& dst, const cv::Mat& src) {
+		Effect::adjustHueSaturation(dst, src, 0.1F, 1.4F, -0.1F);
+	});
+	benchmark8U("colorize", bgra, [](cv::Mat& dst, const cv::Mat& src) {
+		Effect::colorize(dst, src, 0.6F, 0.5F, 0.1F);
+	});
+}
+
+void benchmarkPixelize(const cv::Mat& image)
+{
+	const int sizes[] = { 4, 8, 16, 32, 64 };
+	constexpr int LOOP = 5;
+
+	// full HD frame, as in a video.
+	Mat frame;
+	cv::resize(image, frame, Size(1920, 1080));
+	for(const int size: sizes)
+	{
+		Mat expected, actual;
+		const double reference_time = timeMs([&]() { pixelizeReference(expected, frame, size, size); }, LOOP);
+		const double time = timeMs([&]() { Effect::pixelize(actual, frame, size); }, LOOP);
+
+		std::cout << frame.cols << 'x' << frame.rows << std::fixed << std::setprecision(2) << "  block " << size
+			<< "  cv::sum " << reference_time << "ms  pixelize " << time << "ms  max error "
+			<< cv::norm(expected, actual, NORM_INF) << '\n';
+	}
+
+	// a few faces to mosaic in place, pixels out of them must stay.
+	const std::vector<Rect> faces = { Rect(100, 200, 240, 300), Rect(300, 400, 200, 260), Rect(1700, 900, 400, 400) };
+	Mat mosaic;
+	const double time = timeMs([&]() {
+		frame.copyTo(mosaic);
+		Effect::pixelize(mosaic, faces, 16, 16);
+	}, LOOP);
+
+	Mat mask(frame.size(), CV_8UC1, Scalar(0));
+	for(const Rect& face: faces)
+		mask(face & Rect(0, 0, frame.cols, frame.rows)).setTo(255);
+	Mat expected;
+	pixelizeReference(expected, frame, 16, 16);
+	frame.copyTo(expected, ~mask);
+	std::cout << "  " << faces.size() << " faces in place " << time << "ms  max error "
+		<< cv::norm(expected, mosaic, NORM_INF) << '\n';
+}
+
+void benchmarkUnsharpMask(const cv::Mat& image)
+{
+	Mat frame;
+	cv::resize(image, frame, Size(1920, 1080));
+	constexpr int LOOP = 5;
+	const float radius = 3.0F, amount = 0.8F;
+	const int threshold = 4;
+
+	// two eyes with feathered edges
+	Mat mask(frame.size(), CV_8UC1, Scalar(0));
+	cv::ellipse(mask, Point(820, 480), Size(90, 45), 0, 0, 360, Scalar(255), cv::FILLED);
+	cv::ellipse(mask, Point(1100, 480), Size(90, 45), 0, 0, 360, Scalar(255), cv::FILLED);
+	cv::blur(mask, mask, Size(15, 15));
+
+	Mat expected, actual;
+	const double reference_time = timeMs([&]() {
+		unsharpMaskReference(expected, frame, radius, threshold, amount, mask);
+	}, LOOP);
+	const double time = timeMs([&]() {
+		frame.copyTo(actual);
+		Effect::unsharpMask(actual, radius, threshold, amount, mask);
+	}, LOOP);
+
+	std::cout << frame.cols << 'x' << frame.rows << std::fixed << std::setprecision(2) << "  unsharp mask of eyes float "
+		<< reference_time << "ms  in place " << time << "ms  max error "
+		<< cv::norm(expected, actual, NORM_INF) << '\n';
+}
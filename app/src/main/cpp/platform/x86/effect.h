@@ -12,4 +12,42 @@ void colorize(const std::string& image_name);
 void selectiveGaussianBlur(const cv::Mat& image);
 void selectiveGaussianBlur(const cv::Mat& image, const cv::Mat& mask);
 
+/**
+ * Time recursiveGaussianBlur() against cv::GaussianBlur() of the same sigma for growing radius, and print the error.
+ */
+void benchmarkGaussianBlur(const cv::Mat& image);
+
+/**
+ * Time venus::gaussianBlurSelective() against brute force on the skin region, and print the error.
+ */
+void benchmarkSelectiveBlur(const cv::Mat& image);
+
+/**
+ * Time a chain of Effect color adjustments against the same chain composed by venus::ColorPipeline.
+ */
+void benchmarkColorPipeline(const cv::Mat& image);
+
+/**
+ * Bake a hue/saturation and gamma grading into venus::ColorCube of several sizes, time it against the direct one, and
+ * print the error.
+ */
+void benchmarkColorCube(const cv::Mat& image);
+
+/**
+ * Time 8 bits Effect::adjustHueSaturation() and Effect::colorize() against their float versions, and print the error.
+ */
+void benchmarkHueSaturation(const cv::Mat& image);
+
+/**
+ * Time Effect::pixelize() against averaging blocks with cv::sum() for growing block size on a full HD frame, and the
+ * in-place mosaic of a few rectangles.
+ */
+void benchmarkPixelize(const cv::Mat& image);
+
+/**
+ * Time in-place Effect::unsharpMask() on eye regions of a full HD frame against a float one of the whole frame, and
+ * print the error.
+ */
+void benchmarkUnsharpMask(const cv::Mat& image);
+
 #endif /* EXAMPLE_EFFECT_H_ */
\ No newline at end of file
@@ -1,4 +1,5 @@
 ﻿#include "example/beauty.h"
+#include "example/effect.h"
 #include "example/makeup.h"
 #include "example/utility.h"
 
@@ -23,6 +24,14 @@ int main()
 //	redEyeRemoval_GUI(red_eye_sample);
 	
 //	skinDermabrasion(image);
+//	benchmarkSkinPreview(image);
+//	benchmarkGaussianBlur(image);
+//	benchmarkSelectiveBlur(image);
+//	benchmarkColorPipeline(image);
+//	benchmarkColorCube(image);
+//	benchmarkHueSaturation(image);
+//	benchmarkPixelize(image);
+//	benchmarkUnsharpMask(image);
 
 //	judgeFaceShape(image_name);
 	
@@ -39,5 +48,9 @@ int main()
 //	applyEyeLash(image_name);
 //	applyBrow(image_name);
 
+//	benchmarkBlend();
+//	benchmarkInpaint();
+//	benchmarkInpaintMethods(image);
+
 	return 0;
 }
\ No newline at end of file
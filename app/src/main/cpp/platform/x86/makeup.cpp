@@ -1,8 +1,10 @@
 ﻿#define _USE_MATH_DEFINES
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 #include <stdint.h>
 
 #include <opencv2/core.hpp>
@@ -14,6 +16,8 @@
 #include "example/makeup.h"
 #include "example/utility.h"
 
+#include "venus/Beauty.h"
+#include "venus/blend.h"
 #include "venus/Effect.h"
 #include "venus/Feature.h"
 #include "venus/ImageWarp.h"
@@ -203,6 +207,11 @@ void detectFaceSkin(const std::string& image_name)
 
 	Mat mask_skin = Feature::maskSkinRegion(image.cols, image.rows, points);
 	cv::imshow(__FUNCTION__, mask_skin);
+
+	Mat probability;
+	Mat mask_face = Beauty::calculateSkinRegion_Face(image, points, &probability);
+	cv::imshow("calculateSkinRegion_Face", mask_face);
+	cv::imshow("probability", probability);
 }
 
 /*
@@ -783,4 +792,145 @@ void markBlush(const std::string& image_name)
 	}
 
 	cv::imshow(__FUNCTION__, image);
-}
\ No newline at end of file
+}
+
+// per-pixel implementation which Makeup::blend() used to be, kept as reference.
+static void blendReference(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount)
+{
+	Rect rect = Rect(origin, src.size()) & Rect(0, 0, dst.cols, dst.rows);
+	for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
+	for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+	{
+		const int src_r = r - origin.y, src_c = c - origin.x;
+		if(!mask.empty() && mask.at<uint8_t>(src_r, src_c) == 0)
+			continue;
+
+		const cv::Vec4b& src_color = src.at<cv::Vec4b>(src_r, src_c);
+		if(dst.type() == CV_8UC3)
+		{
+			cv::Vec3b& dst_color = dst.at<cv::Vec3b>(r, c);
+			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3b*>(&src_color), src_color[3]/255.0F * amount);
+		}
+		else
+		{
+			cv::Vec4b& dst_color = dst.at<cv::Vec4b>(r, c);
+			dst_color = mix(dst_color, src_color, amount);
+		}
+	}
+}
+
+void benchmarkBlend()
+{
+	const Size sizes[] = { Size(1920, 1080), Size(3840, 2160) };
+	const int types[] = { CV_8UC3, CV_8UC4 };
+	constexpr int LOOP = 10;
+	const float amount = 0.7F;
+
+	RNG rng(0x5EED);
+	for(const Size& size: sizes)
+	{
+		Mat src(size, CV_8UC4), mask(size, CV_8UC1);
+		rng.fill(src, RNG::UNIFORM, 0, 256);
+		rng.fill(mask, RNG::UNIFORM, 0, 2);  // half of the pixels are masked out
+
+		for(const int type: types)
+		for(int masked = 0; masked <= 1; ++masked)
+		{
+			Mat image(size, type);
+			rng.fill(image, RNG::UNIFORM, 0, 256);
+			const Mat& _mask = masked ? mask : Mat();
+
+			Mat expected = image.clone(), actual = image.clone();
+			const double reference_time = timeMs([&]() {
+				blendReference(expected, src, _mask, Point2i(0, 0), amount);
+			}, LOOP);
+			const double time = timeMs([&]() {
+				if(masked)
+					Makeup::blend(actual, actual, src, mask, Point2i(0, 0), amount);
+				else
+					Makeup::blend(actual, actual, src, Point2i(0, 0), amount);
+			}, LOOP);
+
+			const bool exact = cv::norm(expected, actual, NORM_INF) == 0;
+			std::cout << size.width << 'x' << size.height << (type == CV_8UC3 ? " 8UC3" : " 8UC4") << (masked ? " masked" : "       ")
+				<< std::fixed << std::setprecision(2) << "  reference " << reference_time << "ms"
+				<< "  blend " << time << "ms  speedup " << reference_time / time << "x"
+				<< (exact ? "  bit exact" : "  MISMATCH") << '\n';
+		}
+	}
+}
+
+void benchmarkInpaint()
+{
+	const Size size(1024, 1024);
+	const Point center(size.width/2, size.height/2);
+	const int radii[] = { 64, 128, 256 };
+	constexpr int RING = 24;  // width of source region around the hole
+	constexpr int PATCH_SIZE = 9;
+
+	RNG rng(0x5EED);
+	Mat image(size, CV_8UC3);
+	rng.fill(image, RNG::UNIFORM, 0, 256);
+	cv::GaussianBlur(image, image, Size(0, 0), 3.0);  // some texture for the data term
+
+	for(const int radius: radii)
+	{
+		Mat target_mask = Mat::zeros(size, CV_8UC1), source_mask = Mat::zeros(size, CV_8UC1);
+		cv::circle(source_mask, center, radius + RING, Scalar(255), cv::FILLED);
+		cv::circle(target_mask, center, radius, Scalar(255), cv::FILLED);
+		source_mask.setTo(0, target_mask);
+
+		Inpainter inpainter;
+		inpainter.setSourceImage(image);
+		inpainter.setSourceMask(source_mask);
+		inpainter.setTargetMask(target_mask);
+		inpainter.setPatchSize(PATCH_SIZE);
+
+		const double init_time = timeMs([&]() { inpainter.initialize(); });
+
+		std::vector<double> times;
+		while(inpainter.hasMoreSteps())
+			times.push_back(timeMs([&]() { inpainter.step(); }));
+
+		const size_t quarter = std::max<size_t>(times.size() / 4, 1);
+		double first = 0, last = 0;
+		for(size_t i = 0; i < quarter && i < times.size(); ++i)
+		{
+			first += times[i];
+			last += times[times.size() - 1 - i];
+		}
+
+		std::cout << "radius " << radius << "  steps " << times.size()
+			<< std::fixed << std::setprecision(3) << "  initialize " << init_time << "ms"
+			<< "  per step: first quarter " << first / quarter << "ms"
+			<< ", last quarter " << last / quarter << "ms\n";
+	}
+}
+
+void benchmarkInpaintMethods(const cv::Mat& image)
+{
+	assert(image.type() == CV_8UC3);
+	const int sizes[] = { 16, 32, 64, 128 };
+	const InpaintMethod methods[] = { InpaintMethod::CRIMINISI, InpaintMethod::PATCHMATCH, InpaintMethod::PYRAMID };
+	const char* names[] = { "CRIMINISI ", "PATCHMATCH", "PYRAMID   " };
+	constexpr int RADIUS = 4;
+
+	const Point center(image.cols/2, image.rows/2);
+	for(const int size: sizes)
+	{
+		Mat mask = Mat::zeros(image.size(), CV_8UC1);
+		mask(Rect(center.x - size/2, center.y - size/2, size, size) & Rect(0, 0, image.cols, image.rows)).setTo(255);
+
+		for(size_t i = 0; i < sizeof(methods)/sizeof(methods[0]); ++i)
+		{
+			Mat result = image.clone();
+			result.setTo(Scalar::all(0), mask);  // make sure that nothing of the original leaks through
+
+			const double time = timeMs([&]() { venus::inpaint(result, mask, methods[i], RADIUS); });
+
+			// pixels out of mask are untouched, so the error is averaged over the hole only.
+			std::cout << "hole " << size << 'x' << size << "  " << names[i] << std::fixed << std::setprecision(2)
+				<< "  " << time << "ms  PSNR " << psnr(image, result, mask) << "dB\n";
+		}
+	}
+}
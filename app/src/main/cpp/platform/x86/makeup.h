@@ -42,4 +42,23 @@ void applyIris(const std::string& image_name);
 
 void markBlush(const std::string& image_name);
 
+/**
+ * Compare Makeup::blend() against the former per-pixel implementation at 1080p and 4K, check that results
+ * are bit exact and print the speedup.
+ */
+void benchmarkBlend();
+
+/**
+ * Inpaint disk shaped holes of growing radius with the exemplar based Inpainter, and print the average time of
+ * early and late steps. Source search is confined to a thin ring around the hole so that selecting the next patch
+ * on the fill front shows up, its cost should not grow with the number of steps nor with the size of the hole.
+ */
+void benchmarkInpaint();
+
+/**
+ * Cut square holes of growing size out of the image, fill them with each exemplar based InpaintMethod, and print
+ * the time taken and PSNR of the filled pixels against the original ones.
+ */
+void benchmarkInpaintMethods(const cv::Mat& image);
+
 #endif /* EXAMPLE_MAKEUP_ */
\ No newline at end of file
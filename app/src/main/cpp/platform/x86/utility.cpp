@@ -1,8 +1,11 @@
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 
 #include <Windows.h>
 
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include "example/utility.h"
 #include "venus/compiler.h"
@@ -85,3 +88,31 @@ void testSamples(const std::string& dir, const std::function<void(const cv::Mat&
 		cv::waitKey();
 	}
 }
+
+double timeMs(const std::function<void()>& func, int loop/* = 1 */)
+{
+	assert(loop > 0);
+	const int64 tick = cv::getTickCount();
+	for(int i = 0; i < loop; ++i)
+		func();
+	return (cv::getTickCount() - tick) * 1000.0 / cv::getTickFrequency() / loop;
+}
+
+double psnr(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask/* = cv::Mat() */)
+{
+	assert(a.size() == b.size() && a.type() == b.type());
+	const double peak = a.depth() == CV_8U ? 255.0 : 1.0;
+	const double count = static_cast<double>(mask.empty() ? a.total() : cv::countNonZero(mask)) * a.channels();
+	const double mse = cv::norm(a, b, cv::NORM_L2SQR, mask) / std::max(count, 1.0);
+	return 10 * std::log10(peak * peak / std::max(mse, 1e-10));
+}
+
+cv::Mat toBGRA(const cv::Mat& image)
+{
+	if(image.channels() != 3)
+		return image;
+
+	cv::Mat bgra;
+	cv::cvtColor(image, bgra, cv::COLOR_BGR2BGRA);
+	return bgra;
+}
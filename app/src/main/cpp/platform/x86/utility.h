@@ -33,4 +33,25 @@ std::vector<std::string> listFiles(const std::string& dir, const std::string& ex
 void testSamples(const std::string& dir, const std::function<void(const cv::Mat&)>& func);
 
 
+/**
+ * @param[in] func  Code to time.
+ * @param[in] loop  Times to run @p func.
+ * @return Average wall time of one run in milliseconds.
+ */
+double timeMs(const std::function<void()>& func, int loop = 1);
+
+/**
+ * Peak signal-to-noise ratio in dB, the peak is 255 for CV_8U images and 1 otherwise.
+ *
+ * @param[in] a, b  Images of the same size and type.
+ * @param[in] mask  Optional CV_8UC1 mask, the error is averaged over its nonzero pixels only.
+ */
+double psnr(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask = cv::Mat());
+
+/**
+ * @return @p image converted to BGRA if it's BGR, otherwise @p image itself without copying.
+ */
+cv::Mat toBGRA(const cv::Mat& image);
+
+
 #endif /* EXAMPLE_UTILITY_ */
\ No newline at end of file
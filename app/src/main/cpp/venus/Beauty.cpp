@@ -1,4 +1,6 @@
-﻿#include <cassert>
+﻿#include <algorithm>
+#include <cassert>
+#include <vector>
 
 #include <opencv2/imgproc.hpp>
 
@@ -51,29 +53,10 @@ static bool isSkinColor_RGB(const uint8_t* color)
 	return false;
 }
 
-static cv::Mat calculateSkinRegion(const cv::Mat& image, bool(*predicate)(const uint8_t*))
-{
-	// an RGB/RGBA image is required
-	assert(image.depth() == CV_8U && image.isContinuous());
-
-	const int channel = image.channels();
-	assert(channel >= 3);
-	const int length = image.rows * image.cols;
-	const uint8_t* image_data = image.data;
-
-	Mat mask(image.rows, image.cols, CV_8UC1);
-	uint8_t* mask_data = mask.data;
-
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		mask_data[i] = predicate(image_data + i * channel) ? 255 : 0;
-	
-	return mask;
-}
-
 cv::Mat Beauty::calculateSkinRegion_RGB(const cv::Mat& image)
 {
-	Mat mask = calculateSkinRegion(image, isSkinColor_RGB);
+	Mat mask;
+	classifySkin(image, SkinModel::RGB, &mask, nullptr);
 
 #if 1
 	// post-processing, use closing morphology operation to kick out small holes
@@ -153,51 +136,19 @@ static float skinColorProbability(const uint8_t* color)
 
 cv::Mat Beauty::calculateSkinRegion_YCbCr(const cv::Mat& image)
 {
-	// an RGB/RGBA image is required
-	assert(image.depth() == CV_8U && image.isContinuous());
-
-	const int channel = image.channels();
-	assert(channel >= 3);
-	const int length = image.rows * image.cols;
-	const uint8_t* image_data = image.data;
-
-	Mat mask(image.rows, image.cols, CV_32FC1);
-	float* mask_data = mask.ptr<float>();
-
-/*
-	https://github.com/Itseez/opencv/blob/master/modules/imgproc/src/color.cpp#L7502
-	Currently, there is a bug in conversion CV_BGR2YUV and CV_RGB2YUV,
-	The channels red and blue are misplaced in the implemented formula.
-	see http://code.opencv.org/issues/4227 for details.
-
-	Otherwise, we could use the line below to convert RGB to YUV color mode.
-	cvtColor(image_rgb, image_yuv, CV_BGR2YUV);
-*/
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		mask_data[i] = skinColorProbability(image_data + i * channel);
+	Mat mask;
+	classifySkin(image, SkinModel::YCBCR, nullptr, &mask);
 
 #if 1  // equalization
-	double min; // = *std::min_element(region.begin<float>(), region.end<float>());
-	double max; // = *std::max_element(region.begin<float>(), region.end<float>());
-//	auto min_max = std::minmax_element(region.begin<float>(), region.end<float>());
+	double min, max;
 	cv::minMaxLoc(mask, &min, &max);
-//	std::cout << "min = " << min << ", max = " << max << '\n';
-
-	// binaryzation
-//	float mean = (min + max)/2;
-//	cv::threshold(region, region, mean/* threshold */, 1.0/* max_value */, THRESH_BINARY);
 
-	if(min == max)  // single color in original image, bypass divided by zero.
-		mask.convertTo(mask, CV_8UC1, 255.0F);
-	else
+	if(min != max)  // single color in original image, bypass divided by zero.
 	{
-		// [min, max] maps to [0, 1], y = (x - min)/(max - min);
-		// y = k*x + b; k = 1/(max -min); b = -min/(max -min);
+		// [min, max] maps to [0, 255], y = k*x + b; k = 255/(max - min); b = -min * k;
 		double k = 255/(max - min), b = -min * k;
 		mask.convertTo(mask, CV_8UC1, k, b);
 	}
-//	cv::imshow("mask", mask);
 #endif
 	return mask;
 }
@@ -223,10 +174,223 @@ static bool isSkinColor_HSV(const uint8_t* color)
 
 cv::Mat Beauty::calculateSkinRegion_HSV(const cv::Mat& image)
 {
-	Mat mask = calculateSkinRegion(image, isSkinColor_HSV);
+	Mat mask;
+	classifySkin(image, SkinModel::HSV, &mask, nullptr);
+	return mask;
+}
+
+/*
+	Color cube of skin probability, 64 levels per channel, cell (i, j, k) covers colors [4*i, 4*i + 3] x ... in
+	memory order of channels, so that it doesn't depend on layout. A cell averages 2x2x2 colors inside it, which
+	makes hard decision boundaries of the RGB and HSV rules a bit soft.
+*/
+constexpr int SKIN_CUBE_SHIFT = 2;
+constexpr int SKIN_CUBE_SIZE  = 256 >> SKIN_CUBE_SHIFT;
+
+template <typename Probability>
+static std::vector<uint8_t> bakeSkinCube(Probability probability)
+{
+	std::vector<uint8_t> cube(SKIN_CUBE_SIZE * SKIN_CUBE_SIZE * SKIN_CUBE_SIZE);
+	constexpr int step = 1 << SKIN_CUBE_SHIFT;
+	const int offsets[2] = { step/4, step - 1 - step/4 };  // symmetric about the cell center
+
+	#pragma omp parallel for
+	for(int i = 0; i < SKIN_CUBE_SIZE; ++i)
+	for(int j = 0; j < SKIN_CUBE_SIZE; ++j)
+	for(int k = 0; k < SKIN_CUBE_SIZE; ++k)
+	{
+		float sum = 0;
+		for(int n = 0; n < 8; ++n)
+		{
+			const uint8_t color[3] =
+			{
+				static_cast<uint8_t>(i * step + offsets[(n >> 2) & 1]),
+				static_cast<uint8_t>(j * step + offsets[(n >> 1) & 1]),
+				static_cast<uint8_t>(k * step + offsets[n & 1]),
+			};
+			sum += probability(color);
+		}
+		cube[(i * SKIN_CUBE_SIZE + j) * SKIN_CUBE_SIZE + k] = saturate_cast<uint8_t>(sum * (255 / 8.0F));
+	}
+
+	return cube;
+}
+
+static const uint8_t* getSkinCube(Beauty::SkinModel model)
+{
+	// Baked at first use only, initialization of local static variables is thread safe.
+	switch(model)
+	{
+	case Beauty::SkinModel::RGB:
+	{
+		static const std::vector<uint8_t> cube = bakeSkinCube([](const uint8_t* color) { return isSkinColor_RGB(color) ? 1.0F : 0.0F; });
+		return cube.data();
+	}
+	case Beauty::SkinModel::HSV:
+	{
+		static const std::vector<uint8_t> cube = bakeSkinCube([](const uint8_t* color) { return isSkinColor_HSV(color) ? 1.0F : 0.0F; });
+		return cube.data();
+	}
+	case Beauty::SkinModel::YCBCR:
+	{
+		static const std::vector<uint8_t> cube = bakeSkinCube(skinColorProbability);
+		return cube.data();
+	}
+	default:
+		assert(false);
+		return nullptr;
+	}
+}
+
+/** Cb and Cr in the same way as skinColorProbability(), in fixed point, clamped to [0, 255]. */
+static inline void toCbCr(const uint8_t* color, int& Cb, int& Cr)
+{
+#if USE_BGRA_LAYOUT
+	const int B = color[0], G = color[1], R = color[2];
+#else
+	const int R = color[0], G = color[1], B = color[2];
+#endif
+
+	// weights in Q10
+	const int Y = 306 * R + 601 * G + 117 * B + (16 << 10);
+	Cb = clamp(((504 * ((B << 10) - Y)) >> 20) + 128, 0, 255);
+	Cr = clamp(((898 * ((R << 10) - Y)) >> 20) + 128, 0, 255);
+}
+
+cv::Mat Beauty::calculateSkinRegion_Face(const cv::Mat& image, const std::vector<cv::Point2f>& points, cv::Mat* probability/* = nullptr */)
+{
+	assert(image.depth() == CV_8U && image.channels() >= 3);
+	assert(points.size() == Feature::COUNT);
+
+	Mat mask = Mat::zeros(image.rows, image.cols, CV_8UC1);
+	if(probability != nullptr)
+		*probability = Mat::zeros(image.rows, image.cols, CV_8UC1);
+
+	// Only face and neck can be skin, extend face contour sideways a bit, and downward for neck.
+	const Rect face_rect = cv::boundingRect(std::vector<Point2f>(points.begin(), points.begin() + 20));
+	Rect rect(face_rect.x - face_rect.width/4, face_rect.y - face_rect.height/4,
+			face_rect.width * 3/2, face_rect.height * 2);
+	rect &= Rect(0, 0, image.cols, image.rows);
+	if(rect.area() <= 0)
+		return mask;
+
+	// Sample skin color statistics inside face polygon, which excludes brows, eyes and mouth already.
+	const Mat face_mask = Feature::maskSkinRegion(image.cols, image.rows, points);
+	const int channel = image.channels();
+	double n = 0, sum_b = 0, sum_r = 0, sum_bb = 0, sum_br = 0, sum_rr = 0;
+	for(int r = face_rect.y; r < face_rect.y + face_rect.height; ++r)
+	{
+		if(r < 0 || r >= image.rows)
+			continue;
+
+		const uint8_t* mask_row = face_mask.ptr<uint8_t>(r);
+		const uint8_t* image_row = image.ptr<uint8_t>(r);
+		for(int c = std::max(face_rect.x, 0); c < std::min(face_rect.x + face_rect.width, image.cols); ++c)
+		{
+			if(mask_row[c] == 0)
+				continue;
+
+			int Cb, Cr;
+			toCbCr(image_row + c * channel, Cb, Cr);
+			n += 1;
+			sum_b += Cb;  sum_r += Cr;
+			sum_bb += Cb * Cb;  sum_br += Cb * Cr;  sum_rr += Cr * Cr;
+		}
+	}
+
+	if(n < 16)  // face is hardly visible, fall back to the global model.
+	{
+		Mat roi_mask = mask(rect), roi_probability;
+		classifySkin(image(rect), SkinModel::YCBCR, &roi_mask, probability != nullptr ? &roi_probability : nullptr);
+		if(probability != nullptr)
+			roi_probability.copyTo((*probability)(rect));
+		return mask;
+	}
+
+	// Gaussian model of the face, the covariance is regularized so that a flat lit face doesn't get too narrow.
+	constexpr double REGULARIZATION = 4.0;
+	const double mean_b = sum_b / n, mean_r = sum_r / n;
+	const double var_b  = sum_bb / n - mean_b * mean_b + REGULARIZATION;
+	const double var_r  = sum_rr / n - mean_r * mean_r + REGULARIZATION;
+	const double cov_br = sum_br / n - mean_b * mean_r;
+	const double det = var_b * var_r - cov_br * cov_br;
+	const double inv_bb = var_r / det, inv_br = -cov_br / det, inv_rr = var_b / det;
+
+	// Squared Mahalanobis distance within 6 covers 95% of a 2D Gaussian.
+	constexpr double THRESHOLD = 6.0;
+	std::vector<uint8_t> table(256 * 256), decision(256 * 256);
+	#pragma omp parallel for
+	for(int Cb = 0; Cb < 256; ++Cb)
+	for(int Cr = 0; Cr < 256; ++Cr)
+	{
+		const double db = Cb - mean_b, dr = Cr - mean_r;
+		const double d2 = db * db * inv_bb + 2 * db * dr * inv_br + dr * dr * inv_rr;
+		table[Cb * 256 + Cr] = saturate_cast<uint8_t>(255 * std::exp(-0.5 * d2));
+		decision[Cb * 256 + Cr] = d2 <= THRESHOLD ? 255 : 0;
+	}
+
+	#pragma omp parallel for
+	for(int r = rect.y; r < rect.y + rect.height; ++r)
+	{
+		const uint8_t* color = image.ptr<uint8_t>(r, rect.x);
+		uint8_t* mask_row = mask.ptr<uint8_t>(r);
+		uint8_t* probability_row = probability != nullptr ? probability->ptr<uint8_t>(r) : nullptr;
+		for(int c = rect.x; c < rect.x + rect.width; ++c, color += channel)
+		{
+			int Cb, Cr;
+			toCbCr(color, Cb, Cr);
+			const int index = Cb * 256 + Cr;
+			mask_row[c] = decision[index];
+			if(probability_row != nullptr)
+				probability_row[c] = table[index];
+		}
+	}
+
+	// closing on the region only, as calculateSkinRegion_RGB() does on the whole image.
+	const int radius = std::min(2, cvRound(std::max(rect.width, rect.height) * 0.01F));
+	if(radius > 0)
+	{
+		const Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, Size(radius * 2 + 1, radius * 2 + 1));
+		Mat roi = mask(rect);
+		cv::morphologyEx(roi, roi, cv::MORPH_CLOSE, kernel);
+	}
+
 	return mask;
 }
 
+void Beauty::classifySkin(const cv::Mat& image, SkinModel model, cv::Mat* mask, cv::Mat* probability)
+{
+	assert(image.depth() == CV_8U && image.channels() >= 3);
+	assert(mask != nullptr || probability != nullptr);
+
+	const uint8_t* cube = getSkinCube(model);
+	if(mask != nullptr)
+		mask->create(image.rows, image.cols, CV_8UC1);
+	if(probability != nullptr)
+		probability->create(image.rows, image.cols, CV_8UC1);
+
+	const int channel = image.channels();
+	constexpr int SHIFT = SKIN_CUBE_SHIFT, BITS = 8 - SKIN_CUBE_SHIFT;
+
+	#pragma omp parallel for
+	for(int r = 0; r < image.rows; ++r)
+	{
+		const uint8_t* color = image.ptr<uint8_t>(r);
+		uint8_t* mask_row = mask != nullptr ? mask->ptr<uint8_t>(r) : nullptr;
+		uint8_t* probability_row = probability != nullptr ? probability->ptr<uint8_t>(r) : nullptr;
+
+		for(int c = 0; c < image.cols; ++c, color += channel)
+		{
+			const int index = ((color[0] >> SHIFT) << (2 * BITS)) | ((color[1] >> SHIFT) << BITS) | (color[2] >> SHIFT);
+			const uint8_t p = cube[index];
+			if(mask_row != nullptr)
+				mask_row[c] = p >= 128 ? 255 : 0;
+			if(probability_row != nullptr)
+				probability_row[c] = p;
+		}
+	}
+}
+
 // <gegl>/operations/common/red-eye-removal.c
 void redEyeReduction(float* color, const float& threshold)
 {
@@ -332,46 +496,261 @@ void Beauty::whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, const cv::Ma
 // Refer to paper "Digital Image Enhancement and Noise Filtering by Use of Local Statistics" by Jong-sen Lee, 1979
 void Beauty::beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level)
 {
-	assert(src.rows == mask.rows && src.cols == mask.cols && mask.channels() == 1);
-	double max;
-	Mat _src  = venus::normalize(src, &max);
-	Mat _mask = venus::normalize(mask);
+	assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3 || src.channels() == 4));
+	assert(mask.type() == CV_8UC1 && src.rows == mask.rows && src.cols == mask.cols);
+	assert(radius >= 0 && level >= 0);
 
-//	level = 10 + level * level * 5;
-	int size = cvRound(radius) * 2 + 1;
+	if(dst.data != src.data)
+		src.copyTo(dst);
 
-	// expectation: E[x] = (x1 + x2 + ... + xn)/n;  //x1*p1 + x2*p2 + ... + xn*pn;
-	// variance: Var(X) = E[(X - miu)^2] = E[X^2] - E[X]^2
-	Mat expectation, variance;
-	cv::blur(_src, expectation, Size(size, size), Point(-1, -1), BorderTypes::BORDER_CONSTANT);
+	const Rect rect = cv::boundingRect(mask);
+	if(rect.area() <= 0)
+		return;
+
+	// Pixels within radius of the rectangle are read, only the ones under mask are written.
+	// variance * 65536 below stays in int64_t as long as n = (2r + 1)^2 < 92000, namely r <= 150.
+	const int r = cvRound(radius);
+	assert(r <= 150);
+	const int x0 = std::max(rect.x - r, 0), x1 = std::min(rect.x + rect.width  + r, dst.cols);
+	const int y0 = std::max(rect.y - r, 0), y1 = std::min(rect.y + rect.height + r, dst.rows);
+	const int width = x1 - x0;
+	const int cn = dst.channels();
+	const int channel = std::min(cn, 3);  // alpha is kept as is
+	const int row_size = width * cn;
+
+	// variance is in 8-bit unit, level is in unit of normalized [0, 1] color.
+	const int64_t L = static_cast<int64_t>(level * 255 * 255 + 0.5F);
+
+	// Rows are processed in bands, each band keeps the original rows next to it that neighbor bands overwrite.
+	constexpr int BAND_COUNT = 16;
+	const int band_height = std::max((rect.height + BAND_COUNT - 1) / BAND_COUNT, 1);
+	const int band_count = (rect.height + band_height - 1) / band_height;
+	std::vector<std::vector<uint8_t>> halos(band_count);
 
-	dst = expectation - _src;
-//	cv::multiply(dst, dst, dst);  // dst = dst .* dst;  // element-wise multiplication
-	float* const dst_data = dst.ptr<float>();
-	const int channel = src.channels();
-	const int length = src.rows * src.cols * channel;
+	#pragma omp parallel for
+	for(int band = 0; band < band_count; ++band)
+	{
+		const int b0 = rect.y + band * band_height, b1 = std::min(b0 + band_height, rect.y + rect.height);
+		const int top = std::max(b0 - r, y0), bottom = std::min(b1 + r, y1);
+		std::vector<uint8_t>& halo = halos[band];
+		halo.resize(((b0 - top) + (bottom - b1)) * row_size);
+
+		uint8_t* p = halo.data();
+		for(int y = top; y < b0; ++y, p += row_size)
+			std::copy_n(dst.ptr<uint8_t>(y, x0), row_size, p);
+		for(int y = b1; y < bottom; ++y, p += row_size)
+			std::copy_n(dst.ptr<uint8_t>(y, x0), row_size, p);
+	}
 
 	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-		dst_data[i] *= dst_data[i];
+	for(int band = 0; band < band_count; ++band)
+	{
+		const int b0 = rect.y + band * band_height, b1 = std::min(b0 + band_height, rect.y + rect.height);
+		const int top = std::max(b0 - r, y0), bottom = std::min(b1 + r, y1);
+		const uint8_t* halo = halos[band].data();
 
-	cv::blur(dst, variance, Size(size, size), Point(-1, -1), BorderTypes::BORDER_CONSTANT);
-	
-	const float* _src_data = _src.ptr<float>();
-	const float* _mask_data = _mask.ptr<float>();
-	const float* expectation_data = expectation.ptr<float>();
-	const float* variance_data = variance.ptr<float>();
+		// Original rows in sliding window, plus the one to be subtracted. Rows are written in place right after
+		// computed, so everything is read from here.
+		const int ring_size = 2 * r + 2;
+		std::vector<uint8_t> ring(ring_size * row_size);
+		auto ringRow = [&](int y) { return ring.data() + ((y - y0) % ring_size) * row_size; };
 
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
+		// running sums over columns of window, and prefix sums of them along a row.
+		std::vector<int> column_sum(row_size, 0), column_square(row_size, 0);
+		std::vector<int64_t> prefix_sum((width + 1) * channel), prefix_square((width + 1) * channel);
+
+		auto add = [&](int y, int sign)
+		{
+			const uint8_t* p = ringRow(y);
+			for(int i = 0; i < row_size; ++i)
+			{
+				column_sum[i] += sign * p[i];
+				column_square[i] += sign * p[i] * p[i];
+			}
+		};
+
+		auto fetch = [&](int y)
+		{
+			const uint8_t* p;
+			if(y < b0)
+				p = halo + (y - top) * row_size;
+			else if(y >= b1)
+				p = halo + ((b0 - top) + (y - b1)) * row_size;
+			else
+				p = dst.ptr<uint8_t>(y, x0);
+			std::copy_n(p, row_size, ringRow(y));
+			add(y, 1);
+		};
+
+		for(int y = top; y < std::min(b0 + r, bottom); ++y)
+			fetch(y);
+
+		for(int y = b0; y < b1; ++y)
+		{
+			if(y + r < bottom)
+				fetch(y + r);
+			if(y - r - 1 >= top)
+				add(y - r - 1, -1);
+
+			for(int k = 0; k < channel; ++k)
+			{
+				prefix_sum[k] = prefix_square[k] = 0;
+				for(int x = 0; x < width; ++x)
+				{
+					prefix_sum[(x + 1) * channel + k] = prefix_sum[x * channel + k] + column_sum[x * cn + k];
+					prefix_square[(x + 1) * channel + k] = prefix_square[x * channel + k] + column_square[x * cn + k];
+				}
+			}
+
+			const int rows = std::min(y + r + 1, y1) - std::max(y - r, y0);
+			const uint8_t* mask_row = mask.ptr<uint8_t>(y);
+			const uint8_t* src_row = ringRow(y);
+			uint8_t* dst_row = dst.ptr<uint8_t>(y, x0);
+			for(int x = rect.x - x0; x < rect.x + rect.width - x0; ++x)
+			{
+				const int m = mask_row[x0 + x];
+				if(m == 0)
+					continue;
+
+				const int left = std::max(x - r, 0), right = std::min(x + r + 1, width);
+				const int64_t n = rows * (right - left);
+				for(int k = 0; k < channel; ++k)
+				{
+					const int64_t S = prefix_sum[right * channel + k] - prefix_sum[left * channel + k];
+					const int64_t Q = prefix_square[right * channel + k] - prefix_square[left * channel + k];
+					const int v = src_row[x * cn + k];
+
+					// With mean S/n and variance (nQ - S^2)/n^2, Lee filter gives v + (mean - v) * level/(variance + level),
+					// which is v + (S - n*v)/n * gain, gain = L*n^2 / (nQ - S^2 + L*n^2) = 1 - (nQ - S^2)/denominator.
+					const int64_t variance = n * Q - S * S;
+					const int64_t denominator = variance + L * n * n;
+					if(denominator == 0)
+						continue;
+
+					// gain in Q16, and the delta rounded half away from zero, all in integers.
+					const int64_t gain = 65536 - (variance * 65536 + denominator / 2) / denominator;
+					const int64_t numerator = (S - n * v) * gain * m;
+					const int64_t divisor = n * 65536 * 255;
+					const int64_t delta = (numerator + (numerator < 0 ? -divisor : divisor) / 2) / divisor;
+					dst_row[x * cn + k] = saturate_cast<uint8_t>(v + static_cast<int>(delta));
+				}
+			}
+		}
+	}
+}
+
+void Beauty::retouchSkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, float whiten)
+{
+	assert(src.type() == CV_8UC4 && mask.type() == CV_8UC1 && src.size() == mask.size());
+	assert(whiten == 0 || (2 <= whiten && whiten <= 10));
+
+	beautifySkin(dst, src, mask, radius, level);
+	if(whiten > 0)
+		whitenSkinByLogCurve(dst, dst, mask, whiten);
+}
+
+/** Luminance as guide of upsampling, symmetric in R and B so that it doesn't depend on layout. */
+static inline float guide(const uint8_t* color)
+{
+	return (color[0] + 2 * color[1] + color[2]) / (4 * 255.0F);
+}
+
+void Beauty::previewSkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, float whiten,
+		int proxy_size/* = 512 */)
+{
+	assert(src.type() == CV_8UC4 && mask.type() == CV_8UC1 && src.size() == mask.size());
+	assert(proxy_size > 0);
+
+	if(dst.data != src.data)
+		src.copyTo(dst);
+
+	// Pad the rectangle, so that filters see the surrounding pixels as they do at full resolution.
+	Rect rect = cv::boundingRect(mask);
+	if(rect.area() <= 0)
+		return;
+	const int padding = cvCeil(radius) + 1;
+	rect = Rect(rect.x - padding, rect.y - padding, rect.width + 2 * padding, rect.height + 2 * padding) & Rect(0, 0, src.cols, src.rows);
+
+	const float scale = static_cast<float>(proxy_size) / std::max(rect.width, rect.height);
+	if(scale >= 1.0F)
 	{
-		float k = variance_data[i] / (variance_data[i] + level);
-		float interp = lerp(expectation_data[i], _src_data[i], k);
-//		dst_data[i] = interp;
-		dst_data[i] = lerp(_src_data[i], interp, _mask_data[i/channel]);
+		retouchSkin(dst, dst, mask, radius, level, whiten);
+		return;
 	}
 
-	dst.convertTo(dst, src.depth(), max);  // keep dst and src the same type
+	// Correction of the whole proxy, the mask is applied at full resolution to keep its edges.
+	Mat proxy;
+	const Size proxy_dim(std::max(cvRound(rect.width * scale), 1), std::max(cvRound(rect.height * scale), 1));
+	cv::resize(dst(rect), proxy, proxy_dim, 0, 0, cv::INTER_AREA);
+
+	Mat filtered;
+	const Mat whole(proxy.size(), CV_8UC1, Scalar(255));
+	retouchSkin(filtered, proxy, whole, radius * scale, level, whiten);
+
+	// Guided filter "Guided Image Filtering", Kaiming He et al., in its fast form that fits the linear
+	// coefficients on the proxy and upsamples them, "Fast Guided Filter", Kaiming He and Jian Sun.
+	Mat I(proxy.size(), CV_32FC1), p(proxy.size(), CV_32FC3);
+	for(int r = 0; r < proxy.rows; ++r)
+	{
+		const uint8_t* proxy_row = proxy.ptr<uint8_t>(r);
+		const uint8_t* filtered_row = filtered.ptr<uint8_t>(r);
+		float* I_row = I.ptr<float>(r);
+		float* p_row = p.ptr<float>(r);
+		for(int c = 0; c < proxy.cols; ++c)
+		{
+			I_row[c] = guide(proxy_row + c * 4);
+			for(int k = 0; k < 3; ++k)
+				p_row[c * 3 + k] = (filtered_row[c * 4 + k] - proxy_row[c * 4 + k]) / 255.0F;
+		}
+	}
+
+	constexpr float EPSILON = 1E-3F;
+	const Size window(2 * std::max(cvRound(radius * scale), 1) + 1, 2 * std::max(cvRound(radius * scale), 1) + 1);
+	Mat mean_I, mean_p, mean_II, mean_Ip;
+	cv::boxFilter(I, mean_I, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+	cv::boxFilter(p, mean_p, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+	cv::boxFilter(I.mul(I), mean_II, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+
+	Mat I3;
+	cv::merge(std::vector<Mat>(3, I), I3);
+	cv::boxFilter(I3.mul(p), mean_Ip, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+
+	const Mat variance_I = mean_II - mean_I.mul(mean_I);
+	Mat mean_I3, variance_I3;
+	cv::merge(std::vector<Mat>(3, mean_I), mean_I3);
+	cv::merge(std::vector<Mat>(3, variance_I), variance_I3);
+
+	Mat a = (mean_Ip - mean_I3.mul(mean_p)) / (variance_I3 + Scalar::all(EPSILON));
+	Mat b = mean_p - a.mul(mean_I3);
+	cv::boxFilter(a, a, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+	cv::boxFilter(b, b, CV_32F, window, Point(-1, -1), true, cv::BORDER_REFLECT);
+
+	Mat a_full, b_full;
+	cv::resize(a, a_full, rect.size(), 0, 0, cv::INTER_LINEAR);
+	cv::resize(b, b_full, rect.size(), 0, 0, cv::INTER_LINEAR);
+
+	#pragma omp parallel for
+	for(int r = 0; r < rect.height; ++r)
+	{
+		const uint8_t* mask_row = mask.ptr<uint8_t>(rect.y + r, rect.x);
+		const float* a_row = a_full.ptr<float>(r);
+		const float* b_row = b_full.ptr<float>(r);
+		uint8_t* dst_row = dst.ptr<uint8_t>(rect.y + r, rect.x);
+		for(int c = 0; c < rect.width; ++c)
+		{
+			const int m = mask_row[c];
+			if(m == 0)
+				continue;
+
+			uint8_t* color = dst_row + c * 4;
+			const float g = guide(color);
+			for(int k = 0; k < 3; ++k)
+			{
+				const float correction = a_row[c * 3 + k] * g + b_row[c * 3 + k];
+				color[k] = saturate_cast<uint8_t>(color[k] + correction * m);
+			}
+		}
+	}
 }
 
 } /* namespace venus */
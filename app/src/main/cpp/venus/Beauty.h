@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 
@@ -14,6 +15,36 @@ private:
 
 
 public:
+	/** Color models for skin detection. */
+	enum class SkinModel
+	{
+		RGB,    ///< rules of RGB components, @see calculateSkinRegion_RGB()
+		HSV,    ///< decision boundary in HSV color space, @see calculateSkinRegion_HSV()
+		YCBCR,  ///< Gaussian model of CbCr, @see calculateSkinRegion_YCbCr()
+	};
+
+	/**
+	 * Classify each pixel by looking it up in a color cube of skin probability, which is baked once per model at
+	 * first use. It's much faster than evaluating the model per pixel, at the cost of quantizing colors into 64 levels.
+	 *
+	 * @param[in]  image        An RGB(A) image of uint8_t type.
+	 * @param[in]  model        The color model.
+	 * @param[out] mask         Optional, 255 for skin and 0 for the others.
+	 * @param[out] probability  Optional, skin probability in range [0, 255].
+	 */
+	static void classifySkin(const cv::Mat& image, SkinModel model, cv::Mat* mask, cv::Mat* probability);
+
+	/**
+	 * Skin detection guided by the face. A Gaussian model of CbCr is fitted to the pixels inside face polygon, see
+	 * Feature::maskSkinRegion(), so that it adapts to the person and the lighting. Only a region around the face
+	 * extended downward for neck is classified, the rest of the image is left as background.
+	 *
+	 * @param[in]  image        An RGB(A) image of uint8_t type.
+	 * @param[in]  points       Feature points detected from @p image.
+	 * @param[out] probability  Optional, skin probability in range [0, 255].
+	 * @return Single channel mask of uint8_t type, 255 for skin and 0 for the others.
+	 */
+	static cv::Mat calculateSkinRegion_Face(const cv::Mat& image, const std::vector<cv::Point2f>& points, cv::Mat* probability = nullptr);
 
 	/**
 	 * Skin detection is performed in the RGB colour space, its predicative rules are very much subject to the influence of illumination
@@ -28,7 +59,7 @@ public:
 	 * because facial color region can be described by Gaussian distribution.
 	 *
 	 * @param[in] image an RGB(A) image
-	 * @return single channel mask of float type
+	 * @return single channel mask of uint8_t type, probability is stretched to full range.
 	 */
 	static cv::Mat calculateSkinRegion_YCbCr(const cv::Mat& image);
 
@@ -65,7 +96,42 @@ public:
 	static void whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, float level);
 	static void whitenSkinByLogCurve(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float level);
 	
+	/**
+	 * Smooth skin with Lee filter, which pulls a pixel toward its local mean, less so where local variance is high.
+	 * Local statistics come from running sums, so the cost per pixel doesn't depend on @p radius, and only the
+	 * bounding rectangle of @p mask is visited. All the math is in integers.
+	 *
+	 * @param[out] dst     It can be @p src itself.
+	 * @param[in]  src     CV_8UC1, CV_8UC3 or CV_8UC4 image, alpha channel is kept as is.
+	 * @param[in]  mask    CV_8UC1 skin mask of the same size, 0 leaves a pixel untouched, 255 applies fully.
+	 * @param[in]  radius  Window radius in pixels, no more than 150.
+	 * @param[in]  level   Noise variance in unit of normalized color, the bigger, the smoother.
+	 */
 	static void beautifySkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level);
+
+	/**
+	 * Smooth skin, then whiten it, at full resolution. This is the path for final export, @see previewSkin()
+	 *
+	 * @param[out] dst     It can be @p src itself.
+	 * @param[in]  src     CV_8UC4 image.
+	 * @param[in]  mask    CV_8UC1 skin mask of the same size.
+	 * @param[in]  radius  @see beautifySkin()
+	 * @param[in]  level   @see beautifySkin()
+	 * @param[in]  whiten  Level of whitenSkinByLogCurve() in range [2, 10], or 0 to skip whitening.
+	 */
+	static void retouchSkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, float whiten);
+
+	/**
+	 * Fast approximation of retouchSkin() for live preview. Filters run on a proxy of the mask's bounding rectangle,
+	 * downsampled so that its longer side is at most @p proxy_size, then the correction (filtered minus original) is
+	 * upsampled by a guided filter against the full resolution image, so that it follows edges of the image rather
+	 * than being blurry. The correction is finally masked at full resolution.
+	 *
+	 * @param[in]  proxy_size  Longer side of the proxy in pixels, it falls back to retouchSkin() if the rectangle is no larger.
+	 * @see retouchSkin() for the other parameters.
+	 */
+	static void previewSkin(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float level, float whiten,
+			int proxy_size = 512);
 };
 
 } /* namespace venus */
@@ -0,0 +1,255 @@
+#include "venus/ColorCube.h"
+#include "venus/compiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+using namespace cv;
+
+namespace venus {
+
+// memory index of red and blue channel
+#if USE_BGRA_LAYOUT
+static constexpr int RED = 2, BLUE = 0;
+#else
+static constexpr int RED = 0, BLUE = 2;
+#endif
+
+ColorCube::ColorCube(int size/* = 33 */):
+	size(size),
+	lattice(size * size * size),
+	domain_min(0, 0, 0),
+	domain_max(1, 1, 1)
+{
+	assert(2 <= size && size <= 256);
+	const float scale = 1.0F / (size - 1);
+	for(int b = 0, i = 0; b < size; ++b)
+		for(int g = 0; g < size; ++g)
+			for(int r = 0; r < size; ++r, ++i)
+				lattice[i] = Vec4f(r * scale, g * scale, b * scale, 0.0F);
+}
+
+ColorCube ColorCube::bake(int size, const std::function<void(cv::Mat& image)>& operation, int depth/* = CV_32F */)
+{
+	assert(depth == CV_8U || depth == CV_32F);
+	ColorCube cube(size);
+
+	// row is (blue, green) index, column is red index
+	Mat image(size * size, size, CV_32FC4);
+	for(int i = 0; i < size * size * size; ++i)
+	{
+		const Vec4f& color = cube.lattice[i];
+		Vec4f& pixel = image.at<Vec4f>(i / size, i % size);
+		pixel[RED] = color[0];
+		pixel[1] = color[1];
+		pixel[BLUE] = color[2];
+		pixel[3] = 1.0F;  // opaque
+	}
+
+	if(depth == CV_8U)
+	{
+		image.convertTo(image, CV_8UC4, 255.0);
+		operation(image);
+		image.convertTo(image, CV_32FC4, 1/255.0);
+	}
+	else
+		operation(image);
+	assert(image.type() == CV_32FC4 && image.rows == size * size && image.cols == size);
+
+	for(int i = 0; i < size * size * size; ++i)
+	{
+		const Vec4f& pixel = image.at<Vec4f>(i / size, i % size);
+		cube.lattice[i] = Vec4f(pixel[RED], pixel[1], pixel[BLUE], 0.0F);
+	}
+	return cube;
+}
+
+cv::Vec3f ColorCube::at(int r, int g, int b) const
+{
+	assert(0 <= r && r < size && 0 <= g && g < size && 0 <= b && b < size);
+	const Vec4f& color = lattice[(b * size + g) * size + r];
+	return Vec3f(color[0], color[1], color[2]);
+}
+
+void ColorCube::apply(cv::Mat& dst, const cv::Mat& src) const
+{
+	assert(src.type() == CV_8UC3 || src.type() == CV_8UC4);
+	dst.create(src.size(), src.type());
+	const int N = src.channels();
+
+	// lattice offset of the lower point and fraction to the upper one, for each 8 bits value of red, green and blue.
+	int offset[3][256];
+	float fraction[3][256];
+	const int strides[3] = { 1, size, size * size };
+	for(int k = 0; k < 3; ++k)
+	{
+		const float scale = (size - 1) / (domain_max[k] - domain_min[k]);
+		for(int v = 0; v < 256; ++v)
+		{
+			float x = (v / 255.0F - domain_min[k]) * scale;
+			x = std::min(std::max(x, 0.0F), static_cast<float>(size - 1));
+			const int i = std::min(static_cast<int>(x), size - 2);
+			offset[k][v] = i * strides[k];
+			fraction[k][v] = x - i;
+		}
+	}
+
+	const float* points = &lattice[0][0];
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint8_t* q = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols; ++c, p += N, q += N)
+		{
+			const uint8_t red = p[RED], green = p[1], blue = p[BLUE];
+			const float fr = fraction[0][red], fg = fraction[1][green], fb = fraction[2][blue];
+
+			// walk along axes in order of descending fraction, which picks one of the 6 tetrahedra in the cell.
+			int d1, d2;
+			float f1, f2, f3;
+			if(fr >= fg)
+			{
+				if(fg >= fb)      { d1 = strides[0]; d2 = strides[1]; f1 = fr; f2 = fg; f3 = fb; }
+				else if(fr >= fb) { d1 = strides[0]; d2 = strides[2]; f1 = fr; f2 = fb; f3 = fg; }
+				else              { d1 = strides[2]; d2 = strides[0]; f1 = fb; f2 = fr; f3 = fg; }
+			}
+			else
+			{
+				if(fr >= fb)      { d1 = strides[1]; d2 = strides[0]; f1 = fg; f2 = fr; f3 = fb; }
+				else if(fg >= fb) { d1 = strides[1]; d2 = strides[2]; f1 = fg; f2 = fb; f3 = fr; }
+				else              { d1 = strides[2]; d2 = strides[1]; f1 = fb; f2 = fg; f3 = fr; }
+			}
+
+			const int v0 = offset[0][red] + offset[1][green] + offset[2][blue];
+			const int v1 = v0 + d1, v2 = v1 + d2, v3 = v0 + strides[0] + strides[1] + strides[2];
+			const float w0 = (1 - f1) * 255, w1 = (f1 - f2) * 255, w2 = (f2 - f3) * 255, w3 = f3 * 255;
+
+			int color[4];
+#if CV_SIMD128
+			const v_float32x4 sum = v_load(points + v0 * 4) * v_setall_f32(w0) + v_load(points + v1 * 4) * v_setall_f32(w1)
+					+ v_load(points + v2 * 4) * v_setall_f32(w2) + v_load(points + v3 * 4) * v_setall_f32(w3);
+			v_store(color, v_round(sum));
+#else
+			for(int k = 0; k < 3; ++k)
+				color[k] = cvRound(points[v0 * 4 + k] * w0 + points[v1 * 4 + k] * w1
+						+ points[v2 * 4 + k] * w2 + points[v3 * 4 + k] * w3);
+#endif
+			q[RED]  = saturate_cast<uint8_t>(color[0]);
+			q[1]    = saturate_cast<uint8_t>(color[1]);
+			q[BLUE] = saturate_cast<uint8_t>(color[2]);
+			if(N == 4)
+				q[3] = p[3];  // keep alpha untouched
+		}
+	}
+}
+
+bool ColorCube::load(std::istream& stream)
+{
+	int cube_size = 0;
+	std::vector<Vec4f> points;
+	Vec3f min(0, 0, 0), max(1, 1, 1);
+	std::string cube_title;
+
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		std::string keyword;
+		if(!(fields >> keyword) || keyword[0] == '#')
+			continue;
+
+		if(keyword == "TITLE")
+		{
+			const size_t begin = line.find('"'), end = line.rfind('"');
+			if(begin != std::string::npos && end > begin)
+				cube_title = line.substr(begin + 1, end - begin - 1);
+		}
+		else if(keyword == "LUT_3D_SIZE")
+		{
+			if(!(fields >> cube_size) || cube_size < 2 || cube_size > 256)
+				return false;
+			points.reserve(cube_size * cube_size * cube_size);
+		}
+		else if(keyword == "DOMAIN_MIN")
+		{
+			if(!(fields >> min[0] >> min[1] >> min[2]))
+				return false;
+		}
+		else if(keyword == "DOMAIN_MAX")
+		{
+			if(!(fields >> max[0] >> max[1] >> max[2]))
+				return false;
+		}
+		else if(keyword == "LUT_1D_SIZE" || keyword == "LUT_1D_INPUT_RANGE")
+			return false;  // 1D tables are not supported
+		else if(keyword == "LUT_3D_INPUT_RANGE")
+		{
+			float from, to;
+			if(!(fields >> from >> to))
+				return false;
+			min = Vec3f(from, from, from);
+			max = Vec3f(to, to, to);
+		}
+		else if(std::isalpha(static_cast<unsigned char>(keyword[0])))
+			continue;  // unknown keywords are skipped, as the format suggests
+		else
+		{
+			Vec4f color(0, 0, 0, 0);
+			fields.clear();
+			fields.seekg(0);
+			if(cube_size == 0 || !(fields >> color[0] >> color[1] >> color[2]))
+				return false;
+			points.push_back(color);
+		}
+	}
+
+	if(cube_size == 0 || points.size() != static_cast<size_t>(cube_size * cube_size * cube_size))
+		return false;
+	for(int k = 0; k < 3; ++k)
+		if(!(min[k] < max[k]))
+			return false;
+
+	size = cube_size;
+	lattice.swap(points);
+	domain_min = min;
+	domain_max = max;
+	title = cube_title;
+	return true;
+}
+
+bool ColorCube::load(const std::string& path)
+{
+	std::ifstream stream(path);
+	return stream && load(stream);
+}
+
+bool ColorCube::save(std::ostream& stream) const
+{
+	if(!title.empty())
+		stream << "TITLE \"" << title << "\"\n";
+	stream << "LUT_3D_SIZE " << size << '\n';
+	if(domain_min != Vec3f(0, 0, 0) || domain_max != Vec3f(1, 1, 1))
+	{
+		stream << "DOMAIN_MIN " << domain_min[0] << ' ' << domain_min[1] << ' ' << domain_min[2] << '\n';
+		stream << "DOMAIN_MAX " << domain_max[0] << ' ' << domain_max[1] << ' ' << domain_max[2] << '\n';
+	}
+
+	stream << std::fixed << std::setprecision(6);
+	for(const Vec4f& color: lattice)
+		stream << color[0] << ' ' << color[1] << ' ' << color[2] << '\n';
+	return static_cast<bool>(stream);
+}
+
+bool ColorCube::save(const std::string& path) const
+{
+	std::ofstream stream(path);
+	return stream && save(stream);
+}
+
+} /* namespace venus */
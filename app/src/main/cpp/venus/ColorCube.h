@@ -0,0 +1,91 @@
+#ifndef VENUS_COLOR_CUBE_H_
+#define VENUS_COLOR_CUBE_H_
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace venus {
+
+/**
+ * A 3D color lookup table, a lattice of size^3 RGB colors which maps any color by tetrahedral interpolation between
+ * the four lattice points around it. Unlike ColorPipeline, it can hold operations that mix channels, like
+ * Effect::adjustHueSaturation() or Effect::colorize(), by baking them on the lattice once. Typical sizes are 17, 33
+ * and 65. Presets are loaded from and saved to the Adobe/Resolve .cube text format.
+ *
+ * <pre>
+ *	ColorCube cube = ColorCube::bake(33, [](cv::Mat& image)
+ *	{
+ *		cv::Mat adjusted;
+ *		Effect::adjustHueSaturation(adjusted, image, 0.05F, 1.2F);
+ *		Effect::adjustGamma(image, adjusted, 1.1F);
+ *	});
+ *	cube.apply(image, image);
+ * </pre>
+ */
+class ColorCube
+{
+private:
+	int size;
+	std::vector<cv::Vec4f> lattice;  ///< RGB in range [0, 1] and a padding, red changes fastest, then green, then blue
+	cv::Vec3f domain_min, domain_max;  ///< input RGB range mapped onto the lattice
+	std::string title;
+
+public:
+	/**
+	 * An identity cube.
+	 *
+	 * @param[in] size  Lattice points per axis, in range [2, 256].
+	 */
+	explicit ColorCube(int size = 33);
+
+	/**
+	 * Bake an image operation on the lattice. @p operation is called once on an image holding all the lattice colors,
+	 * it must work pixel by pixel, in place, and keep the size of image.
+	 *
+	 * @param[in] size       Lattice points per axis, in range [2, 256].
+	 * @param[in] operation  The operation to bake, it receives a 4 channels image in venus' memory layout.
+	 * @param[in] depth      CV_32F for range [0, 1], or CV_8U for operations working on 8 bits only.
+	 */
+	static ColorCube bake(int size, const std::function<void(cv::Mat& image)>& operation, int depth = CV_32F);
+
+	int getSize() const { return size; }
+
+	const std::string& getTitle() const { return title; }
+	void setTitle(const std::string& title) { this->title = title; }
+
+	/**
+	 * @return The lattice color at red @p r, green @p g and blue @p b index, in range [0, 1].
+	 */
+	cv::Vec3f at(int r, int g, int b) const;
+
+	/**
+	 * Map the colors of an image, alpha channel is kept.
+	 *
+	 * @param[out] dst  The output image, it can be @p src.
+	 * @param[in]  src  CV_8UC3 or CV_8UC4 image.
+	 */
+	void apply(cv::Mat& dst, const cv::Mat& src) const;
+
+	/**
+	 * Read a .cube file, only 3D tables are supported.
+	 *
+	 * @return true on success, false if it can't be read or parsed, and this cube is left unchanged.
+	 */
+	bool load(std::istream& stream);
+	bool load(const std::string& path);
+
+	/**
+	 * Write a .cube file.
+	 *
+	 * @return true on success, false otherwise.
+	 */
+	bool save(std::ostream& stream) const;
+	bool save(const std::string& path) const;
+};
+
+} /* namespace venus */
+#endif /* VENUS_COLOR_CUBE_H_ */
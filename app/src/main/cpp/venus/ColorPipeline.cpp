@@ -0,0 +1,149 @@
+#include "venus/ColorPipeline.h"
+#include "venus/opencv_utility.h"
+#include "venus/scalar.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+
+namespace venus {
+
+ColorPipeline::ColorPipeline()
+{
+	for(int k = 0; k < 3; ++k)
+		for(int i = 0; i < 256; ++i)
+			tables[k][i] = static_cast<uint8_t>(i);
+}
+
+ColorPipeline& ColorPipeline::compose(const uint8_t next[3][256])
+{
+	for(int k = 0; k < 3; ++k)
+		for(int i = 0; i < 256; ++i)
+			tables[k][i] = next[k][tables[k][i]];
+	return *this;
+}
+
+ColorPipeline& ColorPipeline::append(const ColorPipeline& next)
+{
+	return compose(next.tables);
+}
+
+ColorPipeline& ColorPipeline::mapColor(const uint8_t table[256])
+{
+	for(int k = 0; k < 3; ++k)
+		for(int i = 0; i < 256; ++i)
+			tables[k][i] = table[tables[k][i]];
+	return *this;
+}
+
+ColorPipeline& ColorPipeline::mapColor(int channel, const uint8_t table[256])
+{
+	assert(0 <= channel && channel < 3);
+	for(int i = 0; i < 256; ++i)
+		tables[channel][i] = table[tables[channel][i]];
+	return *this;
+}
+
+ColorPipeline& ColorPipeline::adjustGamma(float gamma)
+{
+	return adjustGamma(Vec3f(gamma, gamma, gamma));
+}
+
+ColorPipeline& ColorPipeline::adjustGamma(const cv::Vec3f& gamma)
+{
+	uint8_t next[3][256];
+	for(int k = 0; k < 3; ++k)
+	{
+		assert(gamma[k] > 0);
+		const float inv_gamma = 1 / gamma[k];
+		for(int i = 0; i < 256; ++i)
+			next[k][i] = cvRound(std::pow(i/255.0, inv_gamma) * 255.0);
+	}
+	return compose(next);
+}
+
+ColorPipeline& ColorPipeline::adjustBrightnessAndContrast(float brightness, float contrast)
+{
+	assert(-0.5F <= brightness && brightness <= 0.5F);
+	assert(0.0F <= contrast && contrast < std::numeric_limits<float>::infinity());
+
+	uint8_t table[256];
+	for(int i = 0; i < 256; ++i)
+	{
+		const float x = i/255.0F;
+		float value;
+		if(brightness < 0.0F)
+			value = x * (1.0F + brightness);  // [0, x]
+		else
+			value = x + ((1.0F - x) * brightness);  // [x, 1]
+
+		value = (value - 0.5F) * contrast + 0.5F;
+		table[i] = saturate_cast<uint8_t>(value * 256.0F);
+	}
+	return mapColor(table);
+}
+
+ColorPipeline& ColorPipeline::posterize(float level)
+{
+	assert(1.0F <= level && level <= 256.0F);
+	level = 256 / level;
+
+	uint8_t table[256];
+	for(int i = 0; i < 256; ++i)
+		table[i] = cvRound(std::floor(i / level) * level);
+	return mapColor(table);
+}
+
+ColorPipeline& ColorPipeline::tone(uint32_t color, float amount)
+{
+	const float l_amount = 1.0F - amount;
+	const Vec4f target = cast(color) * (255.0F * amount);
+
+	uint8_t next[3][256];
+	for(int k = 0; k < 3; ++k)
+		for(int i = 0; i < 256; ++i)
+			next[k][i] = saturate_cast<uint8_t>(i * l_amount + target[k]);
+	return compose(next);
+}
+
+void ColorPipeline::apply(cv::Mat& dst, const cv::Mat& src) const
+{
+	const int N = src.channels();
+	assert(src.depth() == CV_8U && N <= 4);
+
+	// cv::LUT() maps each channel with its own table when the table has as many channels as the image.
+	Mat lut(1, 256, CV_MAKETYPE(CV_8U, N));
+	uint8_t* data = lut.ptr<uint8_t>();
+	for(int i = 0; i < 256; ++i)
+		for(int k = 0; k < N; ++k)
+			data[i * N + k] = k < 3 ? tables[k][i] : static_cast<uint8_t>(i);
+
+	cv::LUT(src, lut, dst);
+}
+
+void ColorPipeline::apply(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask) const
+{
+	const int N = src.channels(), M = std::min(N, 3);
+	assert(src.depth() == CV_8U && N <= 4);
+	assert(mask.type() == CV_8UC1 && mask.size() == src.size());
+	dst.create(src.size(), src.type());
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* m = mask.ptr<uint8_t>(r);
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint8_t* q = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols; ++c, p += N, q += N)
+		{
+			const uint8_t amount = m[c];
+			for(int k = 0; k < M; ++k)
+				q[k] = lerp(p[k], tables[k][p[k]], amount);
+			if(N == 4)
+				q[3] = p[3];  // keep alpha untouched
+		}
+	}
+}
+
+} /* namespace venus */
@@ -0,0 +1,90 @@
+#ifndef VENUS_COLOR_PIPELINE_H_
+#define VENUS_COLOR_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+namespace venus {
+
+/**
+ * A chain of per-channel point operations on 8 bits images, composed into one 256 entries table per color channel.
+ * Effects like gamma, brightness and contrast each used to make a pass over the image, a filter preset chaining them
+ * makes a single pass here, and gets the very same result since every step is rounded to 8 bits as before.
+ *
+ * <pre>
+ *	ColorPipeline pipeline;
+ *	pipeline.adjustBrightnessAndContrast(0.1F, 1.2F).adjustGamma(1.1F).tone(0xFF3080C0, 0.2F);
+ *	pipeline.apply(image, image);
+ * </pre>
+ *
+ * Operations that mix channels, like Effect::adjustColorBalance() or Effect::adjustHueSaturation(), can't be put in.
+ */
+class ColorPipeline
+{
+private:
+	uint8_t tables[3][256];  ///< in memory order of color channels, alpha channel is never mapped
+
+	ColorPipeline& compose(const uint8_t next[3][256]);
+
+public:
+	/**
+	 * An identity pipeline which maps every value to itself.
+	 */
+	ColorPipeline();
+
+	/**
+	 * @return The table of color channel @p channel in range [0, 3).
+	 */
+	const uint8_t* getTable(int channel) const { return tables[channel]; }
+
+	/**
+	 * Append another pipeline to this one, so that @p next is applied afterwards.
+	 */
+	ColorPipeline& append(const ColorPipeline& next);
+
+	/**
+	 * Append a table on all color channels.
+	 */
+	ColorPipeline& mapColor(const uint8_t table[256]);
+
+	/**
+	 * Append a table on color channel @p channel only, in range [0, 3).
+	 */
+	ColorPipeline& mapColor(int channel, const uint8_t table[256]);
+
+	/// @see Effect::adjustGamma(cv::Mat&, const cv::Mat&, float)
+	ColorPipeline& adjustGamma(float gamma);
+
+	/// @see Effect::adjustGamma(cv::Mat&, const cv::Mat&, const cv::Vec3f&)
+	ColorPipeline& adjustGamma(const cv::Vec3f& gamma);
+
+	/// @see Effect::adjustBrightnessAndContrast()
+	ColorPipeline& adjustBrightnessAndContrast(float brightness, float contrast);
+
+	/// @see Effect::posterize()
+	ColorPipeline& posterize(float level);
+
+	/// @see Effect::tone(cv::Mat&, const cv::Mat&, uint32_t, float)
+	ColorPipeline& tone(uint32_t color, float amount);
+
+	/**
+	 * Map all the pixels in one pass, alpha channel is kept.
+	 *
+	 * @param[out] dst  The output image, it can be @p src.
+	 * @param[in]  src  CV_8UC1, CV_8UC3 or CV_8UC4 image, single channel image is mapped by the first table.
+	 */
+	void apply(cv::Mat& dst, const cv::Mat& src) const;
+
+	/**
+	 * Map the pixels in one pass and blend them with the original ones by @p mask, alpha channel is kept.
+	 *
+	 * @param[out] dst   The output image, it can be @p src.
+	 * @param[in]  src   CV_8UC1, CV_8UC3 or CV_8UC4 image, single channel image is mapped by the first table.
+	 * @param[in]  mask  CV_8UC1 weight of the same size as @p src, 0 keeps the pixel, 255 maps it fully.
+	 */
+	void apply(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask) const;
+};
+
+} /* namespace venus */
+#endif /* VENUS_COLOR_PIPELINE_H_ */
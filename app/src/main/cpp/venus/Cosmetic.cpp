@@ -0,0 +1,182 @@
+#include "venus/colorspace.h"
+#include "venus/Cosmetic.h"
+#include "venus/opencv_utility.h"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+
+namespace venus {
+
+static void premultiply(cv::Mat& image)
+{
+	assert(image.type() == CV_8UC4);
+
+	#pragma omp parallel for
+	for(int r = 0; r < image.rows; ++r)
+	{
+		uint8_t* p = image.ptr<uint8_t>(r);
+		for(int c = 0; c < image.cols; ++c, p += 4)
+		{
+			const int a = p[3];
+			p[0] = static_cast<uint8_t>((p[0] * a + 127) / 255);
+			p[1] = static_cast<uint8_t>((p[1] * a + 127) / 255);
+			p[2] = static_cast<uint8_t>((p[2] * a + 127) / 255);
+		}
+	}
+}
+
+static cv::Mat whiteToAlpha(const cv::Mat& mask)
+{
+	assert(mask.type() == CV_8UC3 || mask.type() == CV_8UC4);
+
+	cv::Mat mask2 = mask.clone();
+	if(mask2.channels() == 3)
+		cvtColor(mask2, mask2, COLOR_BGR2BGRA);
+	mask2.convertTo(mask2, CV_32FC4, 1/255.0);
+
+	const Vec3f FROM_COLOR(1.0F, 1.0F, 1.0F);  // white
+	const int length = mask.rows * mask.cols;
+	float* mask2_data = mask2.ptr<float>();
+	const float* from = &FROM_COLOR[0];
+
+	#pragma omp parallel for
+	for(int i = 0; i < length; ++i)
+	{
+		float* p = mask2_data + (i<<2);
+		color2alpha(from, p, p);
+	}
+	mask2.convertTo(mask2, CV_8UC4, 255.0);
+	return mask2;
+}
+
+Cosmetic::Cosmetic(const cv::Mat& image, Kind kind/* = Kind::PLAIN */)
+{
+	cv::Mat level;
+	switch(kind)
+	{
+	case Kind::PLAIN:
+		assert(image.type() == CV_8UC4 || image.type() == CV_8UC1);
+		level = image.clone();
+		break;
+	case Kind::IRIS:
+		level = whiteToAlpha(image);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+
+	if(level.channels() == 4)
+		premultiply(level);
+	levels.push_back(level);
+
+	// Box filter over 2x2 pixels, stop at a size that is too small to be worth sampling from.
+	constexpr int MIN_SIZE = 8;
+	while(std::min(level.cols, level.rows) >= MIN_SIZE * 2)
+	{
+		cv::Mat next;
+		cv::resize(level, next, Size((level.cols + 1)/2, (level.rows + 1)/2), 0, 0, cv::INTER_AREA);
+		levels.push_back(next);
+		level = next;
+	}
+}
+
+const cv::Mat& Cosmetic::getLevel(int level) const
+{
+	assert(0 <= level && level < getLevelCount());
+	return levels[level];
+}
+
+int Cosmetic::selectLevel(float scale) const
+{
+	assert(scale > 0);
+	int level = 0;
+	while(level + 1 < getLevelCount() && levels[level + 1].cols >= levels[0].cols * scale
+			&& levels[level + 1].rows >= levels[0].rows * scale)
+		++level;
+
+	return level;
+}
+
+cv::Point2f Cosmetic::mapToLevel(const cv::Point2f& point, int level) const
+{
+	const cv::Mat& image = getLevel(level);
+	const float sx = static_cast<float>(image.cols) / levels[0].cols;
+	const float sy = static_cast<float>(image.rows) / levels[0].rows;
+
+	// pixel centers are at integer positions, so align the edges of pixel instead.
+	return Point2f((point.x + 0.5F) * sx - 0.5F, (point.y + 0.5F) * sy - 0.5F);
+}
+
+Makeup::Layer Cosmetic::createLayer(const Makeup::Mapping& mapping, float amount, uint32_t color/* = 0 */) const
+{
+	const Vec4f& scale = mapping.scale;
+	const float min_scale = std::min(std::min(scale[0], scale[1]), std::min(scale[2], scale[3]));
+	const int level = selectLevel(min_scale);
+	const cv::Mat& image = levels[level];
+
+	const float fx = static_cast<float>(levels[0].cols) / image.cols;
+	const float fy = static_cast<float>(levels[0].rows) / image.rows;
+
+	Makeup::Mapping level_mapping = mapping;
+	level_mapping.pivot = mapToLevel(mapping.pivot, level);
+	level_mapping.scale = Vec4f(scale[0] * fx, scale[1] * fy, scale[2] * fx, scale[3] * fy);
+
+	return Makeup::Layer{image, Mat(), Point2i(), amount, color, true, level_mapping, isPremultiplied()};
+}
+
+struct CosmeticCacheEntry
+{
+	uint64_t key;  ///< content fingerprint of source image and kind
+	cv::Size size;  ///< source image size
+	int type;       ///< source image type
+	std::shared_ptr<const Cosmetic> cosmetic;
+};
+
+static std::mutex cache_mutex;
+static std::list<CosmeticCacheEntry> cache;  // most recently used at front
+
+std::shared_ptr<const Cosmetic> Cosmetic::get(const cv::Mat& image, Kind kind/* = Kind::PLAIN */)
+{
+	constexpr size_t CAPACITY = 16;
+	// Cosmetics are usually bitmaps locked from Java side, whose addresses may change or be reused between
+	// calls, so they are looked up by content. Hashing goes a word at a time, far cheaper than preprocessing.
+	// Size and type are compared too, so that a hash collision of different shaped images can't return the
+	// wrong levels.
+	const int kind_value = static_cast<int>(kind);
+	const uint64_t key = fingerprint(image, fingerprint(&kind_value, sizeof(kind_value)));
+	const Size size = image.size();
+	const int type = image.type();
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for(auto it = cache.begin(); it != cache.end(); ++it)
+			if(it->key == key && it->size == size && it->type == type)
+			{
+				cache.splice(cache.begin(), cache, it);
+				return cache.front().cosmetic;
+			}
+	}
+
+	// Preprocess out of lock, other threads may do the same template at the same time, which is harmless.
+	std::shared_ptr<const Cosmetic> cosmetic = std::make_shared<const Cosmetic>(image, kind);
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache.push_front(CosmeticCacheEntry{key, size, type, cosmetic});
+	if(cache.size() > CAPACITY)
+		cache.pop_back();
+
+	return cosmetic;
+}
+
+void Cosmetic::clearCache()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache.clear();
+}
+
+} /* namespace venus */
@@ -0,0 +1,87 @@
+#ifndef VENUS_COSMETIC_H_
+#define VENUS_COSMETIC_H_
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "venus/Makeup.h"
+
+namespace venus {
+
+/**
+ * A cosmetic template (brow, eye, lash, shadow, iris) preprocessed once into a chain of levels, each one half the
+ * size of the previous one. RGBA templates are stored with premultiplied alpha, so that neither downsampling nor
+ * interpolation bleeds the color of transparent pixels. Scaling it to a face then samples the nearest level with a
+ * bilinear filter, instead of resampling the original bitmap with Lanczos every time.
+ *
+ * A Cosmetic is immutable once created, share it read-only across threads with std::shared_ptr.
+ *
+ * <pre>
+ *	std::shared_ptr<const Cosmetic> brow = Cosmetic::get(image);  // cached, the second call is cheap.
+ *	Makeup::blend(dst, brow->createLayer(mapping, amount, color), Rect(0, 0, dst.cols, dst.rows));
+ * </pre>
+ */
+class Cosmetic
+{
+public:
+	enum class Kind
+	{
+		PLAIN,  ///< CV_8UC4 template, or CV_8UC1 coverage of a color.
+		IRIS,   ///< CV_8UC3 or CV_8UC4 iris on white background, white is turned into transparency.
+	};
+
+private:
+	std::vector<cv::Mat> levels;  ///< levels[0] is of original size
+
+public:
+	/**
+	 * @param[in] image  The template, it's copied.
+	 * @param[in] kind   How to preprocess @p image.
+	 */
+	explicit Cosmetic(const cv::Mat& image, Kind kind = Kind::PLAIN);
+
+	/**
+	 * Look up the process wide cache for @p image by its content, and create one if there is none. Since the
+	 * key is the content, templates passed in as a new cv::Mat each time (like a locked Java bitmap) still hit.
+	 * It's safe to call from multiple threads.
+	 */
+	static std::shared_ptr<const Cosmetic> get(const cv::Mat& image, Kind kind = Kind::PLAIN);
+
+	static void clearCache();
+
+	int getLevelCount() const { return static_cast<int>(levels.size()); }
+	const cv::Mat& getLevel(int level) const;
+
+	/**
+	 * @return true if levels are CV_8UC4 with premultiplied alpha, false if they are CV_8UC1 coverage.
+	 */
+	bool isPremultiplied() const { return levels[0].channels() == 4; }
+
+	/**
+	 * @param[in] scale  Scaling factor relative to the original size, pass the smallest one if it's anisotropic.
+	 * @return The smallest level which is still no smaller than original image scaled by @p scale.
+	 */
+	int selectLevel(float scale) const;
+
+	/**
+	 * @param[in] point  Position on the original template.
+	 * @param[in] level  Level index.
+	 * @return The same position on @p level.
+	 */
+	cv::Point2f mapToLevel(const cv::Point2f& point, int level) const;
+
+	/**
+	 * Create a layer which samples the proper level of this template through @p mapping while blending.
+	 *
+	 * @param[in] mapping  Mapping from the original template onto destination image.
+	 * @param[in] amount   Blending amount in range [0, 1], 0 being no effect, 1 being fully applied.
+	 * @param[in] color    0xAABBGGRR, only used if the template is a coverage mask.
+	 */
+	Makeup::Layer createLayer(const Makeup::Mapping& mapping, float amount, uint32_t color = 0) const;
+};
+
+} /* namespace venus */
+#endif /* VENUS_COSMETIC_H_ */
@@ -1,9 +1,13 @@
 ﻿#ifdef _WIN32
 #	define _USE_MATH_DEFINES  // for M_PI
 #endif
+#include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
+#include <vector>
 
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/imgproc.hpp>
 #if TRACE_IMAGES 
 #include <opencv2/highgui.hpp>
@@ -11,6 +15,7 @@
 
 #include "venus/blur.h"
 #include "venus/colorspace.h"
+#include "venus/ColorPipeline.h"
 #include "venus/Effect.h"
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
@@ -132,22 +137,12 @@ void Effect::tone(cv::Mat& dst, const cv::Mat& src, uint32_t color, float amount
 	dst.create(src.size(), src.type());
 
 	const float l_amount = 1.0F - amount;
-	if(src.depth() == CV_32F)
-		amount /= 255;
-
-	Vec4f target = cast(color) * amount;
+	Vec4f target = cast(color) * amount;  // in range [0, 1]
 	
 	switch(src.type())
 	{
 	case CV_8UC4:
-		for(int r = 0; r < src.rows; ++r)
-		for(int c = 0; c < src.cols; ++c)
-		{
-			const Vec4b& src_color = src.at<Vec4b>(r, c);
-			Vec4b& dst_color = dst.at<Vec4b>(r, c);
-			for(int i = 0; i < 3; ++i)  // loop unrolling
-				dst_color[i] = static_cast<uint8_t>(src_color[i] * l_amount + target[i]);
-		}
+		ColorPipeline().tone(color, amount).apply(dst, src);
 		break;
 	case CV_32FC4:
 		for(int r = 0; r < src.rows; ++r)
@@ -174,14 +169,7 @@ void Effect::posterize(cv::Mat& dst, const cv::Mat& src, float level)
 		src.copyTo(dst);
 
 	if(depth == CV_8U)
-	{
-		level = 256 / level;
-		uint8_t table[256];
-		for(int i = 0; i < 256; ++i)
-			table[i] = cvRound(std::floor(i / level) * level);
-	
-		mapColor(dst, src, table);
-	}
+		ColorPipeline().posterize(level).apply(dst, src);
 	else if(depth == CV_32F)
 	{
 		float* data = dst.ptr<float>();
@@ -208,30 +196,139 @@ void Effect::posterize(cv::Mat& dst, const cv::Mat& src, float level)
 		assert(false);
 }
 
+/**
+ * Fill blocks of a grid starting at image origin with their averages, within @p rect whose edges lie on the grid or
+ * image border. Each block row sums up its pixels once, so the cost doesn't depend on block size.
+ *
+ * @param[in] mask  Empty, or CV_8UC1 of @p rect size, only pixels of nonzero mask are filled.
+ */
+template <typename T, typename S>
+static void pixelizeBlocks(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Rect& rect,
+		int width, int height)
+{
+	const int N = src.channels();
+	const int block_rows = (rect.height + height - 1) / height;
+	const int block_cols = (rect.width  + width  - 1) / width;
+
+	#pragma omp parallel for
+	for(int br = 0; br < block_rows; ++br)
+	{
+		const int r0 = rect.y + br * height, r1 = std::min(r0 + height, rect.y + rect.height);
+		std::vector<S> sums(block_cols * N, 0);
+		for(int r = r0; r < r1; ++r)
+		{
+			const T* p = src.ptr<T>(r) + rect.x * N;
+			for(int bc = 0; bc < block_cols; ++bc)
+			{
+				S* sum = sums.data() + bc * N;
+				const int block_width = std::min(width, rect.width - bc * width);
+				for(int c = 0; c < block_width; ++c, p += N)
+					for(int k = 0; k < N; ++k)
+						sum[k] += p[k];
+			}
+		}
+
+		std::vector<T> averages(block_cols * N);
+		for(int bc = 0; bc < block_cols; ++bc)
+		{
+			const int area = (r1 - r0) * std::min(width, rect.width - bc * width);
+			for(int k = 0; k < N; ++k)
+				averages[bc * N + k] = saturate_cast<T>(static_cast<double>(sums[bc * N + k]) / area);
+		}
+
+		for(int r = r0; r < r1; ++r)
+		{
+			const uint8_t* m = mask.empty() ? nullptr : mask.ptr<uint8_t>(r - rect.y);
+			T* q = dst.ptr<T>(r) + rect.x * N;
+			for(int bc = 0, c = 0; bc < block_cols; ++bc)
+			{
+				const T* average = averages.data() + bc * N;
+				const int c_end = std::min(c + width, rect.width);
+				for(; c < c_end; ++c, q += N)
+				{
+					if(m != nullptr && m[c] == 0)
+						continue;
+
+					for(int k = 0; k < N; ++k)
+						q[k] = average[k];
+				}
+			}
+		}
+	}
+}
+
+static void pixelizeBlocks(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Rect& rect,
+		int width, int height)
+{
+	switch(src.depth())
+	{
+	case CV_8U:  // an uint32_t sum holds blocks up to 16M pixels
+		pixelizeBlocks<uint8_t, uint32_t>(dst, src, mask, rect, width, height);
+		break;
+	case CV_32F:
+		pixelizeBlocks<float, double>(dst, src, mask, rect, width, height);
+		break;
+	default:
+		assert(false);  // unimplemented branch goes here.
+		break;
+	}
+}
+
+// Grow @p rect to the grid of blocks starting at image origin, and clip it by image of @p size.
+static cv::Rect alignToBlocks(const cv::Rect& rect, const cv::Size& size, int width, int height)
+{
+	const int x0 = rect.x / width * width, y0 = rect.y / height * height;
+	const int x1 = (rect.x + rect.width  + width  - 1) / width  * width;
+	const int y1 = (rect.y + rect.height + height - 1) / height * height;
+	return Rect(x0, y0, x1 - x0, y1 - y0) & Rect(0, 0, size.width, size.height);
+}
+
 void Effect::pixelize(cv::Mat& dst, const cv::Mat& src, int width, int height)
 {
 	assert(width > 0 && height > 0);
 	dst.create(src.rows, src.cols, src.type());
-	
-	const int br_count = (src.rows + height - 1) / height;
-	const int bc_count = (src.cols + width  - 1) / width;
-	for(int br = 0; br < br_count; ++br)
+	pixelizeBlocks(dst, src, Mat(), Rect(0, 0, src.cols, src.rows), width, height);
+}
+
+void Effect::pixelize(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, int width, int height)
+{
+	assert(width > 0 && height > 0);
+	assert(mask.type() == CV_8UC1 && mask.size() == src.size());
+	if(dst.data != src.data)
+		src.copyTo(dst);
+
+	const Rect bounds = cv::boundingRect(mask);
+	if(bounds.area() <= 0)
+		return;
+
+	const Rect rect = alignToBlocks(bounds, src.size(), width, height);
+	pixelizeBlocks(dst, src, mask(rect), rect, width, height);
+}
+
+void Effect::pixelize(cv::Mat& image, const std::vector<cv::Rect>& rects, int width, int height)
+{
+	assert(width > 0 && height > 0);
+	const Rect image_rect(0, 0, image.cols, image.rows);
+	Rect bounds;
+	for(const Rect& rect: rects)
 	{
-		int sr0 = br * height;
-		int height = std::min(height, src.rows - sr0);
-		
-		for(int bc = 0; bc < bc_count; ++bc)
-		{
-			int sc0 = bc * width;
-			int width = std::min(width, src.cols - sc0);
-			Rect rect(sc0, sr0, width, height);
-			
-			Scalar sum = cv::sum(src(rect));
-			Scalar avg = sum / (width * height);
-			
-			dst(rect).setTo(avg);
-		}
+		const Rect clipped = rect & image_rect;
+		if(clipped.area() > 0)
+			bounds = bounds.area() > 0 ? (bounds | clipped) : clipped;
+	}
+	if(bounds.area() <= 0)
+		return;
+
+	// Blocks on edges of rectangles are averaged as a whole, but pixels outside are kept.
+	const Rect rect = alignToBlocks(bounds, image.size(), width, height);
+	Mat mask(rect.size(), CV_8UC1, Scalar(0));
+	for(const Rect& r: rects)
+	{
+		const Rect clipped = r & image_rect;
+		if(clipped.area() > 0)
+			mask(clipped - rect.tl()).setTo(255);
 	}
+	pixelizeBlocks(image, image, mask, rect, width, height);
 }
 
 cv::Mat Effect::grayscale(const cv::Mat& image)
@@ -255,12 +352,220 @@ cv::Mat Effect::grayscale(const cv::Mat& image)
 	return gray;
 }
 
+// memory index of red and blue channel
+#if USE_BGRA_LAYOUT
+static constexpr int RED = 2, BLUE = 0;
+#else
+static constexpr int RED = 0, BLUE = 2;
+#endif
+
+// luminance weights of RGB used by colorize()
+static constexpr float LUMINANCE_R = 0.22248840F;
+static constexpr float LUMINANCE_G = 0.71690369F;
+static constexpr float LUMINANCE_B = 0.06060791F;
+
+static inline float adjustLightness(float luminance, float lightness)
+{
+	if(lightness > 0)
+		return (1.0F - lightness) * luminance + lightness;
+	else
+		return luminance * (1.0F + lightness);
+}
+
+/**
+ * Colorize 8 bits image through a table of luminance in 1/16 code value, which keeps result within one code value of
+ * the float version.
+ */
+static void colorize_8U(cv::Mat& dst, const cv::Mat& src, float hue, float saturation, float lightness)
+{
+	constexpr int LEVELS = 255 * 16 + 1;
+	const int weight_r = cvRound(LUMINANCE_R * 4096), weight_b = cvRound(LUMINANCE_B * 4096);
+	const int weight_g = 4096 - weight_r - weight_b;
+
+	std::vector<cv::Vec3b> table(LEVELS);
+	for(int i = 0; i < LEVELS; ++i)
+	{
+		const float hsl[3] = { hue, saturation, adjustLightness(i / (16 * 255.0F), lightness) };
+		float rgb[3];
+		hsl2rgb(hsl, rgb);
+		for(int k = 0; k < 3; ++k)
+			table[i][k] = saturate_cast<uint8_t>(rgb[k] * 255.0F);
+	}
+
+	const int N = src.channels();
+	dst.create(src.size(), src.type());
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint8_t* q = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < src.cols; ++c, p += N, q += N)
+		{
+			const cv::Vec3b& color = table[(weight_r * p[RED] + weight_g * p[1] + weight_b * p[BLUE] + 128) >> 8];
+			q[RED]  = color[0];
+			q[1]    = color[1];
+			q[BLUE] = color[2];
+			if(N == 4)
+				q[3] = p[3];  // keep alpha untouched
+		}
+	}
+}
+
+static inline void shiftHsl(float* hsl, float hue, float saturation, float lightness)
+{
+	// wrap around interval [0, 1], make sure that hue interval length is 1.
+	hsl[0] += hue;
+	if(hsl[0] < 0.0F)
+		hsl[0] += 1.0F;
+	else if(hsl[0] > 1.0F)
+		hsl[0] -= 1.0F;
+
+	hsl[1] *= saturation;
+	hsl[1] = clamp(hsl[1]);
+
+	float v = lightness;
+	if(v < 0.0F)
+		hsl[2] *= (v + 1.0F);
+	else
+		hsl[2] += v * (1.0F - hsl[2]);
+}
+
+#if CV_SIMD128
+/*
+ * The same as rgb2hsl(), shiftHsl() and hsl2rgb() in a row, on 4 pixels without branches. Hue is kept in
+ * range [0, 6], and each channel of hsl2rgb() is m1 + (m2 - m1) * clamp(min(x, 4 - x), 0, 1) with x being hue shifted.
+ */
+static inline void shiftHsl(cv::v_float32x4& r, cv::v_float32x4& g, cv::v_float32x4& b,
+		float hue, float saturation, float lightness)
+{
+	const cv::v_float32x4 zero = cv::v_setzero_f32(), one = cv::v_setall_f32(1.0F), half = cv::v_setall_f32(0.5F);
+	const cv::v_float32x4 two = cv::v_setall_f32(2.0F), four = cv::v_setall_f32(4.0F), six = cv::v_setall_f32(6.0F);
+
+	const cv::v_float32x4 max = cv::v_max(cv::v_max(r, g), b), min = cv::v_min(cv::v_min(r, g), b);
+	const cv::v_float32x4 sum = max + min, delta = max - min;
+	const cv::v_float32x4 chromatic = delta > zero;  // gray has no hue nor saturation
+	const cv::v_float32x4 l = sum * half;
+	const cv::v_float32x4 inv_delta = one / cv::v_select(chromatic, delta, one);
+
+	cv::v_float32x4 h = cv::v_select(r == max, (g - b) * inv_delta,
+			cv::v_select(g == max, two + (b - r) * inv_delta, four + (r - g) * inv_delta));
+	h = h + cv::v_setall_f32(hue * 6.0F);
+	h = cv::v_select(h < zero, h + six, h);
+	h = cv::v_select(h > six, h - six, h);
+	h = cv::v_select(chromatic, h, zero);
+
+	cv::v_float32x4 s = cv::v_select(chromatic, delta / cv::v_select(l <= half, sum, two - sum), zero);
+	s = cv::v_min(cv::v_max(s * cv::v_setall_f32(saturation), zero), one);
+
+	const float scale = lightness < 0.0F ? 1.0F + lightness : 1.0F - lightness;
+	const float offset = lightness < 0.0F ? 0.0F : lightness;
+	const cv::v_float32x4 l2 = l * cv::v_setall_f32(scale) + cv::v_setall_f32(offset);
+	const cv::v_float32x4 m2 = cv::v_select(l2 <= half, l2 * (one + s), l2 + s - l2 * s);
+	const cv::v_float32x4 m1 = l2 + l2 - m2;
+
+	auto channel = [&](cv::v_float32x4 x) -> cv::v_float32x4
+	{
+		x = cv::v_select(x > six, x - six, x);
+		x = cv::v_select(x < zero, x + six, x);
+		const cv::v_float32x4 t = cv::v_min(cv::v_max(cv::v_min(x, four - x), zero), one);
+		return m1 + (m2 - m1) * t;
+	};
+
+	r = channel(h + two);
+	g = channel(h);
+	b = channel(h - two);
+}
+
+static inline void expandNormalized(const cv::v_uint8x16& value, cv::v_float32x4 result[4])
+{
+	cv::v_uint16x8 word0, word1;
+	cv::v_expand(value, word0, word1);
+
+	cv::v_uint32x4 dword[4];
+	cv::v_expand(word0, dword[0], dword[1]);
+	cv::v_expand(word1, dword[2], dword[3]);
+	for(int i = 0; i < 4; ++i)
+		result[i] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(dword[i])) * cv::v_setall_f32(1/255.0F);
+}
+
+static inline cv::v_uint8x16 packNormalized(const cv::v_float32x4 value[4])
+{
+	const cv::v_float32x4 scale = cv::v_setall_f32(255.0F);
+	return cv::v_pack_u(cv::v_pack(cv::v_round(value[0] * scale), cv::v_round(value[1] * scale)),
+			cv::v_pack(cv::v_round(value[2] * scale), cv::v_round(value[3] * scale)));
+}
+#endif  // CV_SIMD128
+
+/**
+ * Effect::adjustHueSaturation() of 8 bits image without float copies, it's within one code value of the float version.
+ */
+static void adjustHueSaturation_8U(cv::Mat& dst, const cv::Mat& src, float hue, float saturation, float lightness)
+{
+	const int N = src.channels();
+	dst.create(src.size(), src.type());
+
+	#pragma omp parallel for
+	for(int r = 0; r < src.rows; ++r)
+	{
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint8_t* q = dst.ptr<uint8_t>(r);
+		int c = 0;
+#if CV_SIMD128
+		for(; c <= src.cols - 16; c += 16)
+		{
+			cv::v_uint8x16 channels[4];
+			if(N == 4)
+				cv::v_load_deinterleave(p + c * 4, channels[0], channels[1], channels[2], channels[3]);
+			else
+				cv::v_load_deinterleave(p + c * 3, channels[0], channels[1], channels[2]);
+
+			cv::v_float32x4 red[4], green[4], blue[4];
+			expandNormalized(channels[RED], red);
+			expandNormalized(channels[1], green);
+			expandNormalized(channels[BLUE], blue);
+			for(int i = 0; i < 4; ++i)
+				shiftHsl(red[i], green[i], blue[i], hue, saturation, lightness);
+			channels[RED] = packNormalized(red);
+			channels[1] = packNormalized(green);
+			channels[BLUE] = packNormalized(blue);
+
+			if(N == 4)
+				cv::v_store_interleave(q + c * 4, channels[0], channels[1], channels[2], channels[3]);
+			else
+				cv::v_store_interleave(q + c * 3, channels[0], channels[1], channels[2]);
+		}
+#endif
+		for(; c < src.cols; ++c)
+		{
+			const uint8_t* color = p + c * N;
+			uint8_t* result = q + c * N;
+			const float rgb[3] = { color[RED] / 255.0F, color[1] / 255.0F, color[BLUE] / 255.0F };
+			float hsl[3], shifted[3];
+			rgb2hsl(rgb, hsl);
+			shiftHsl(hsl, hue, saturation, lightness);
+			hsl2rgb(hsl, shifted);
+
+			result[RED]  = saturate_cast<uint8_t>(shifted[0] * 255.0F);
+			result[1]    = saturate_cast<uint8_t>(shifted[1] * 255.0F);
+			result[BLUE] = saturate_cast<uint8_t>(shifted[2] * 255.0F);
+			if(N == 4)
+				result[3] = color[3];  // keep alpha untouched
+		}
+	}
+}
+
 void Effect::colorize(cv::Mat& dst, const cv::Mat& src, float hue/* = 0.0F */, float saturation/* = 0.5F */, float lightness/* = 0.0F*/)
 {
-	assert(src.type() == CV_32FC4 && src.data != dst.data);
 	assert(0.0F <= hue && hue <= 1.0F);
 	assert(0.0F <= saturation && saturation <= 1.0F);
 	assert(-1.0F <= lightness && lightness <= 1.0F);
+	if(src.type() == CV_8UC3 || src.type() == CV_8UC4)
+	{
+		colorize_8U(dst, src, hue, saturation, lightness);
+		return;
+	}
+
+	assert(src.type() == CV_32FC4 && src.data != dst.data);
 	src.copyTo(dst);
 
 	float hsl[3];
@@ -270,10 +575,6 @@ void Effect::colorize(cv::Mat& dst, const cv::Mat& src, float hue/* = 0.0F */, f
 	const int length = src.rows * src.cols * 4;
 	const float* src_color = src.ptr<float>();
 	float* dst_color = dst.ptr<float>();
-	
-	constexpr float LUMINANCE_R = 0.22248840F;
-	constexpr float LUMINANCE_G = 0.71690369F;
-	constexpr float LUMINANCE_B = 0.06060791F;
 
 #if USE_BGRA_LAYOUT
 	constexpr int _0 = 2, _1 = 1, _2 = 0;
@@ -283,13 +584,7 @@ void Effect::colorize(cv::Mat& dst, const cv::Mat& src, float hue/* = 0.0F */, f
 	for(int i = 0; i < length; i += 4)
 	{
 		float luminance = LUMINANCE_R * src_color[_0] + LUMINANCE_G * src_color[_1] + LUMINANCE_B * src_color[_2];
-
-		if(lightness > 0)
-			luminance = (1.0F - lightness) * luminance + lightness;
-		else
-			luminance*= (1.0F + lightness);
-
-		hsl[2] = luminance;
+		hsl[2] = adjustLightness(luminance, lightness);
 
 		float rgb[3];
 		hsl2rgb(hsl, rgb);
@@ -337,6 +632,59 @@ void Effect::unsharpMask(cv::Mat& dst, const cv::Mat& src,  float radius/* = 5.0
 	src.copyTo(dst, lowContrastMask);
 }
 
+void Effect::unsharpMask(cv::Mat& image, float radius, int threshold, float amount, const cv::Mat& mask/* = cv::Mat() */)
+{
+	assert(image.type() == CV_8UC1 || image.type() == CV_8UC3 || image.type() == CV_8UC4);
+	assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == image.size()));
+	assert(1.0F <= radius);
+	assert(0 <= threshold && threshold <= 255);
+	assert(0.0F <= amount && amount <= 1.0F);
+
+	const Rect rect = mask.empty() ? Rect(0, 0, image.cols, image.rows) : cv::boundingRect(mask);
+	if(rect.area() <= 0)
+		return;
+
+	// Blur a copy of the rectangle with a margin, pixels out of image are replicated rather than taken as zero.
+	const int margin = 2 * cvRound(radius);
+	const Rect padded = Rect(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin)
+			& Rect(0, 0, image.cols, image.rows);
+	Mat blurred;
+	cv::copyMakeBorder(image(padded), blurred, rect.y - margin < 0 ? margin - rect.y : 0,
+			std::max(rect.br().y + margin - image.rows, 0), rect.x - margin < 0 ? margin - rect.x : 0,
+			std::max(rect.br().x + margin - image.cols, 0), BORDER_REPLICATE);
+	venus::gaussianBlur(blurred, blurred, radius);
+
+	// weights of (src - blurred) in 16 bits fraction for each mask value
+	int weights[256];
+	for(int i = 0; i < 256; ++i)
+		weights[i] = cvRound(amount * i / 255 * (1 << 16));
+
+	const int N = image.channels();
+	const int C = N == 4 ? 3 : N;  // alpha is kept
+
+	#pragma omp parallel for
+	for(int r = 0; r < rect.height; ++r)
+	{
+		uint8_t* p = image.ptr<uint8_t>(rect.y + r) + rect.x * N;
+		const uint8_t* q = blurred.ptr<uint8_t>(margin + r) + margin * N;
+		const uint8_t* m = mask.empty() ? nullptr : mask.ptr<uint8_t>(rect.y + r) + rect.x;
+		for(int c = 0; c < rect.width; ++c, p += N, q += N)
+		{
+			const int weight = weights[m != nullptr ? m[c] : 255];
+			if(weight == 0)
+				continue;
+
+			// Sharpened = Original + (Original - Blurred) * Amount
+			for(int k = 0; k < C; ++k)
+			{
+				const int difference = p[k] - q[k];
+				if(std::abs(difference) > threshold)
+					p[k] = saturate_cast<uint8_t>(p[k] + ((difference * weight + (1 << 15)) >> 16));
+			}
+		}
+	}
+}
+
 float Effect::mapColorBalance(float value, float lightness, float shadows, float midtones, float highlights)
 {
 	/* Apply masks to the corrections for shadows, midtones and highlights so that each correction affects only one range.
@@ -433,27 +781,9 @@ void Effect::adjustBrightnessAndContrast(Mat& dst, const Mat& src, float brightn
 //	brightness /= 2.0F;
 //	contrast = std::tan((contrast + 1.0F) * M_PI_4);
 
-	auto brightness_contrast = [&brightness, &contrast](const float& x)
-	{
-		float value;
-		if(brightness < 0.0F)
-			value = x * (1.0F + brightness);  // [0, x]
-		else
-			value = x + ((1.0F - x) * brightness);  // [x, 1]
-
-		value = (value - 0.5F) * contrast + 0.5F;
-		return value;
-	};
-
 	const int depth = src.depth();
 	if(depth == CV_8U)
-	{
-		uint8_t table[256];
-		for(int i = 0; i < 256; ++i)
-			table[i] = saturate_cast<uint8_t>(brightness_contrast(i/255.0F) * 256.0F);
-
-		mapColor(dst, src, table);
-	}
+		ColorPipeline().adjustBrightnessAndContrast(brightness, contrast).apply(dst, src);
 	else if(depth == CV_32F)
 	{
 		if(src.data != dst.data)
@@ -485,21 +815,14 @@ void Effect::adjustBrightnessAndContrast(Mat& dst, const Mat& src, float brightn
 void Effect::adjustGamma(cv::Mat& dst, const cv::Mat& src, float gamma)
 {
 	assert(gamma > 0);
-	gamma = 1/gamma;
 
 	dst.create(src.rows, src.cols, src.type());
 	int depth = src.depth();
 	if(depth == CV_8U)
-	{
-		// build a lookup table mapping the pixel values [0, 255] to their adjusted gamma values
-		uint8_t table[256];
-		for(int i = 0; i < 256; ++i)
-			table[i] = cvRound(std::pow(i/255.0, gamma) * 255.0);
-
-		mapColor(dst, src, table);
-	}
+		ColorPipeline().adjustGamma(gamma).apply(dst, src);
 	else if(depth == CV_32F)
 	{
+		gamma = 1/gamma;
 		const float* src_data = reinterpret_cast<const float*>(src.data);
 		float* const dst_data = reinterpret_cast<float* const>(dst.data);
 		const int channels = src.channels();
@@ -527,6 +850,11 @@ void Effect::adjustGamma(cv::Mat& dst, const cv::Mat& src, float gamma)
 void Effect::adjustGamma(cv::Mat& dst, const cv::Mat& src, const cv::Vec3f& gamma)
 {
 	assert(src.channels() >= 3);
+	if(src.depth() == CV_8U)
+	{
+		ColorPipeline().adjustGamma(gamma).apply(dst, src);
+		return;
+	}
 
 	std::vector<cv::Mat> channels;
 	cv::split(src, channels);
@@ -547,6 +875,11 @@ void Effect::adjustHueSaturation(cv::Mat& dst, const cv::Mat& src, float hue/* =
 	const int depth   = src.depth();
 	const int length  = src.rows * src.cols * channel;
 	assert(channel >= 3 && (depth == CV_8U || depth == CV_32F));
+	if(depth == CV_8U)
+	{
+		adjustHueSaturation_8U(dst, src, hue, saturation, lightness);
+		return;
+	}
 	assert(dst.data != src.data);
 
 	Mat _dst, _src;  // float type storage
@@ -568,23 +901,7 @@ void Effect::adjustHueSaturation(cv::Mat& dst, const cv::Mat& src, float hue/* =
 	{
 		float hsl[3];
 		rgb2hsl(_src_data + i, hsl);
-
-		// wrap around interval [0, 1], make sure that hue interval length is 1.
-		hsl[0] += hue;
-		if(hsl[0] < 0.0F)
-			hsl[0] += 1.0F;
-		else if(hsl[0] > 1.0F)
-			hsl[0] -= 1.0F;
-
-		hsl[1] *= saturation;
-		hsl[1] = clamp(hsl[1]);
-
-		float v = lightness;
-		if(v < 0.0F)
-			hsl[2] *= (v + 1.0F);
-		else
-			hsl[2] += v * (1.0F - hsl[2]);
-		
+		shiftHsl(hsl, hue, saturation, lightness);
 		hsl2rgb(hsl, _dst_data + i);
 	}
 	
@@ -1,6 +1,8 @@
 #ifndef VENUS_EFFECT_H_
 #define VENUS_EFFECT_H_
 
+#include <vector>
+
 #include <opencv2/core.hpp>
 
 namespace venus {
@@ -62,13 +64,36 @@ public:
 	
 	/**
 	 * <a href="https://en.wikipedia.org/wiki/Pixelization">Pixelization</a>
+	 * Blocks are laid on a grid starting at image origin, each pixel is summed up once, so the cost doesn't depend on
+	 * block size.
+	 *
 	 * @param[out] dst    The output image, and in-place pixelizing is supported.
-	 * @param[in]  src    The input image.
+	 * @param[in]  src    The input image, CV_8U or CV_32F of any channels.
 	 * @param[in]  width  Pixel block width, an positive value.
 	 * @param[in]  height Pixel block height, an positive value.
 	 */
 	static void pixelize(cv::Mat& dst, const cv::Mat& src, int width, int height);
 
+	/**
+	 * Pixelize the region of @p mask only, like a mosaic on faces. Blocks are on the same grid as the whole image
+	 * version, and only the blocks around @p mask are visited.
+	 *
+	 * @param[out] dst    The output image, and in-place pixelizing is supported.
+	 * @param[in]  src    The input image, CV_8U or CV_32F of any channels.
+	 * @param[in]  mask   CV_8UC1 mask of the same size as @p src, pixels of nonzero mask are pixelized.
+	 * @param[in]  width  Pixel block width, an positive value.
+	 * @param[in]  height Pixel block height, an positive value.
+	 */
+	static void pixelize(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, int width, int height);
+
+	/**
+	 * Pixelize rectangles of @p image in place, @see pixelize(cv::Mat&, const cv::Mat&, const cv::Mat&, int, int)
+	 *
+	 * @param[in,out] image  CV_8U or CV_32F image of any channels.
+	 * @param[in]     rects  Rectangles to pixelize, they can overlap or go beyond the image.
+	 */
+	static void pixelize(cv::Mat& image, const std::vector<cv::Rect>& rects, int width, int height);
+
 	/**
 	 * Convert a color image into grayscale image.
 	 *
@@ -82,8 +107,9 @@ public:
 	 * it doesn't solve differential equations, which is a time-consuming job. This simple method operates pixel by pixel, so it can run in 
 	 * parallel. You can segment image into several distinct parts, then colorize them with differenct parameters, lastly, merge the parts into
 	 * a beautiful colored image.
-	 * @param[out] dst         The output image.
-	 * @param[in]  src         The input image, only handles image of CV_32FC4 type.
+	 * @param[out] dst         The output image, it can be @p src for 8 bits image.
+	 * @param[in]  src         The input image of CV_32FC4, CV_8UC3 or CV_8UC4 type. 8 bits image is mapped by a table of
+	 *                         luminance, without float copies.
 	 * @param[in]  hue         Range [0.0, 1.0]
 	 * @param[in]  saturation  Range [0.0, 1.0]
 	 * @param[in]  lightness   Range [-1.0, 1.0]
@@ -103,6 +129,20 @@ public:
 	 */
 	static void unsharpMask(cv::Mat& dst, const cv::Mat& src, float radius = 5.0F, int threshold = 0, float amount = 0.5F);
 
+	/**
+	 * Unsharp masking in place on region of @p mask only, like sharpening eyes and brows after makeup. It works in 8 bits
+	 * fixed point, and allocates a buffer of the mask's bounding rectangle plus the blur margin, rather than the whole
+	 * image.
+	 *
+	 * @param[in,out] image      CV_8UC1, CV_8UC3 or CV_8UC4 image, alpha channel is kept.
+	 * @param[in]     radius     Radius of gaussian blur (in pixels > 1.0).
+	 * @param[in]     threshold  Range [0, 255], differences no more than it are left as they are.
+	 * @param[in]     amount     Range [0.0, 1.0], strength of effect.
+	 * @param[in]     mask       Empty for the whole image, or CV_8UC1 of the same size as @p image, its value scales
+	 *                           @p amount, so that a feathered mask fades out smoothly.
+	 */
+	static void unsharpMask(cv::Mat& image, float radius, int threshold, float amount, const cv::Mat& mask = cv::Mat());
+
 	/**
 	 * color balance is the global adjustment of the intensities of the colors (typically red, green, and blue primary colors).
 	 * @see https://en.wikipedia.org/wiki/Color_balance for details.
@@ -147,7 +187,8 @@ public:
 	static void adjustGamma(cv::Mat& dst, const cv::Mat& src, const cv::Vec3f& gamma);
 
 	/**
-	 * Adjust hue, saturation, and lightness.
+	 * Adjust hue, saturation, and lightness. 8 bits image is processed directly with SIMD instead of on a float copy,
+	 * it can be done in place, and the result is within one code value of the float version.
 	 *
 	 * @param[in] hue         Range [-0.5, 0.5], which maps to [-180, 180] degree interval.
 	 * @param[in] saturation  Range [ 0.0, 2.0]
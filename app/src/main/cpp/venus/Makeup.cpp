@@ -2,28 +2,20 @@
 #include "venus/blur.h"
 #include "venus/colorspace.h"
 #include "venus/compiler.h"
+#include "venus/Cosmetic.h"
 #include "venus/Effect.h"
 #include "venus/Feature.h"
 #include "venus/ImageWarp.h"
+#include "venus/inpaint.h"
 #include "venus/Makeup.h"
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
 
-#include <opencv2/imgproc.hpp>
-
-// OpenCV's inpainting algorithm is lame, needs an alternative.
-// 0: disable inpainting algorithm
-// 1: OpenCV's inpainting algorithm
-// 2: Criminisi's inpainting algorithm
-#ifndef USE_INPAINTING /* this macro's moved to makefile */
-#define USE_INPAINTING 0
-#endif
+#include <list>
+#include <mutex>
+#include <utility>
 
-#if(USE_INPAINTING == 1)
-#	include <opencv2/photo.hpp>
-#elif(USE_INPAINTING == 2)
-#	include "venus/inpaint.h"
-#endif /* USE_INPAINTING */
+#include <opencv2/imgproc.hpp>
 
 using namespace cv;
 
@@ -223,295 +215,583 @@ std::vector<cv::Point2f> Makeup::createPolygon(const std::vector<cv::Point2f>& p
 	}
 }
 
-void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Point2i& origin, float amount)
+/*
+	mix() scales alpha of source pixel by amount in float for every pixel, the fixed point path below looks it
+	up instead. Table entries are calculated with the very same expressions, so the result is bit exact.
+*/
+static void createAlphaTable(uint8_t table[256], int channel, float amount)
 {
-	assert(!src.empty() && (src.type() == CV_8UC4 || src.type() == CV_32FC4));
-
-	// Note that dst.copyTo(result); will invoke result.create(src.size(), src.type());
-	// which has this clause if( dims <= 2 && rows == _rows && cols == _cols && type() == _type && data ) return;
-	// which means that result's memory will only be allocated the first time in if result is empty.
-	if(dst.data != result.data)
-		dst.copyTo(result);
+	for(int i = 0; i < 256; ++i)
+		table[i] = saturate_cast<uint8_t>(channel == 4 ? cvRound(i * amount) : cvRound(255 * (i/255.0F * amount)));
+}
 
-	Rect rect_src(origin.x, origin.y, src.cols, src.rows);
-	Rect rect_dst(0, 0, dst.cols, dst.rows);
-	Rect rect = rect_dst & rect_src;
+/**
+ * Blend a row of RGBA pixels onto a row of RGB or RGBA pixels, alpha channel of @p dst is kept untouched.
+ *
+ * @param[in,out] dst      Destination row.
+ * @param[in]     channel  Channel count of @p dst, 3 or 4.
+ * @param[in]     src      Source row of RGBA pixels.
+ * @param[in]     mask     Optional, pixels of value 0 are left untouched.
+ * @param[in]     table    Scaled alpha, @see createAlphaTable()
+ * @param[in]     length   Number of pixels.
+ */
+static void blendRow(uint8_t* dst, int channel, const uint8_t* src, const uint8_t* mask, const uint8_t table[256], int length)
+{
+	constexpr int CHUNK = 128;  // pixels, so that buffers live on stack.
+	uint8_t color[CHUNK * 3], weight[CHUNK * 4];
 
-	switch(dst.type())
+	for(int i = 0; i < length; i += CHUNK)
 	{
-	case CV_8UC3:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+		const int count = std::min(CHUNK, length - i);
+		const uint8_t* s = src + i * 4;
+		uint8_t* d = dst + i * channel;
+		const uint8_t* m = mask != nullptr ? mask + i : nullptr;
+
+		if(channel == 4)
 		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(r - origin.y, c - origin.x);
-			cv::Vec3b& dst_color = result.at<cv::Vec3b>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3b*>(&src_color), src_color[3]/255.0F * amount);
+			for(int k = 0; k < count; ++k)
+			{
+				const uint8_t a = (m == nullptr || m[k] != 0) ? table[s[k*4 + 3]] : 0;
+				uint8_t* w = weight + k * 4;
+				w[0] = w[1] = w[2] = a;
+				w[3] = 0;  // weight 0 keeps alpha untouched
+			}
+			mix(d, d, s, weight, count * 4);
 		}
-		break;
-	case CV_8UC4:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+		else
 		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(r - origin.y, c - origin.x);
-			cv::Vec4b& dst_color = result.at<cv::Vec4b>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			for(int k = 0; k < count; ++k)
+			{
+				const uint8_t a = (m == nullptr || m[k] != 0) ? table[s[k*4 + 3]] : 0;
+				uint8_t* w = weight + k * 3;
+				uint8_t* c = color  + k * 3;
+				w[0] = w[1] = w[2] = a;
+				c[0] = s[k*4 + 0];  c[1] = s[k*4 + 1];  c[2] = s[k*4 + 2];
+			}
+			mix(d, d, color, weight, count * 3);
 		}
-		break;
-#if 0  // currently unused case
-	case CV_32FC3:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+	}
+}
+
+/**
+ * Like blendRow(), but RGB of @p src is premultiplied by alpha, so color is scaled by amount instead of mixed.
+ */
+static void blendPremultipliedRow(uint8_t* dst, int channel, const uint8_t* src, const uint8_t* mask, const uint8_t table[256], int length)
+{
+	constexpr int CHUNK = 128;  // pixels, so that buffers live on stack.
+	static const uint8_t ZERO[CHUNK * 4] = {};
+	uint8_t color[CHUNK * 4], weight[CHUNK * 4];
+
+	for(int i = 0; i < length; i += CHUNK)
+	{
+		const int count = std::min(CHUNK, length - i);
+		const uint8_t* s = src + i * 4;
+		uint8_t* d = dst + i * channel;
+		const uint8_t* m = mask != nullptr ? mask + i : nullptr;
+
+		for(int k = 0; k < count; ++k)
 		{
-			const cv::Vec3f& src_color = src.at<cv::Vec3f>(r - origin.y, c - origin.x);
-			cv::Vec3f& dst_color = result.at<cv::Vec3f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			const bool visible = m == nullptr || m[k] != 0;
+			const uint8_t a = visible ? table[s[k*4 + 3]] : 0;
+			uint8_t* w = weight + k * channel;
+			uint8_t* c = color  + k * channel;
+			for(int j = 0; j < 3; ++j)
+			{
+				w[j] = a;
+				c[j] = visible ? table[s[k*4 + j]] : 0;
+			}
+			if(channel == 4)
+				w[3] = c[3] = 0;  // keeps alpha untouched
 		}
-		break;
-	case CV_32FC4:
-		for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-		for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+
+		// dst * (1 - alpha * amount) + color * amount
+		mix(d, d, ZERO, weight, count * channel);
+		for(int k = 0; k < count * channel; ++k)
+			d[k] = static_cast<uint8_t>(std::min(d[k] + color[k], 255));
+	}
+}
+
+/**
+ * Blend a constant color through a coverage mask onto a row of RGB or RGBA pixels, alpha channel of @p dst is
+ * kept untouched.
+ *
+ * @param[in,out] dst       Destination row.
+ * @param[in]     channel   Channel count of @p dst, 3 or 4.
+ * @param[in]     color     Color in memory layout of @p dst.
+ * @param[in]     coverage  Row of coverage mask, namely alpha of the color.
+ * @param[in]     mask      Optional, pixels of value 0 are left untouched.
+ * @param[in]     table     Scaled alpha of the color, indexed by coverage.
+ * @param[in]     length    Number of pixels.
+ */
+static void blendColorRow(uint8_t* dst, int channel, const uint8_t color[4], const uint8_t* coverage, const uint8_t* mask,
+		const uint8_t table[256], int length)
+{
+	constexpr int CHUNK = 128;  // pixels, so that buffers live on stack.
+	uint8_t colors[CHUNK * 4], weight[CHUNK * 4];
+	for(int k = 0; k < CHUNK; ++k)
+		std::copy(color, color + channel, colors + k * channel);
+
+	for(int i = 0; i < length; i += CHUNK)
+	{
+		const int count = std::min(CHUNK, length - i);
+		const uint8_t* v = coverage + i;
+		const uint8_t* m = mask != nullptr ? mask + i : nullptr;
+		uint8_t* d = dst + i * channel;
+
+		for(int k = 0; k < count; ++k)
 		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(r - origin.y, c - origin.x);
-			cv::Vec4f& dst_color = result.at<cv::Vec4f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			const uint8_t a = (m == nullptr || m[k] != 0) ? table[v[k]] : 0;
+			uint8_t* w = weight + k * channel;
+			w[0] = w[1] = w[2] = a;
+			if(channel == 4)
+				w[3] = 0;  // weight 0 keeps alpha untouched
 		}
-		break;
-#endif
-	default:
-		assert(false);
-		break;
+		mix(d, d, colors, weight, count * channel);
 	}
 }
 
-void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount)
+cv::Rect Makeup::Mapping::getRect(const cv::Size& size) const
 {
-	assert(!src.empty() && (src.type() == CV_8UC4 || src.type() == CV_32FC4));
-	assert(mask.type() == CV_8UC1);
-	if(dst.data != result.data)
-		dst.copyTo(result);
-
-	Rect rect_src(origin.x, origin.y, src.cols, src.rows);
-	Rect rect_dst(0, 0, dst.cols, dst.rows);
-	Rect rect = rect_dst & rect_src;
+	assert(scale[0] > 0 && scale[1] > 0 && scale[2] > 0 && scale[3] > 0);
 
-	Rect2i rect_mask(0, 0, mask.cols, mask.rows);
-	int offset_x = (src.cols - mask.cols)/2;
-	int offset_y = (src.rows - mask.rows)/2;
+	// Scaling four parts separately still leaves a rectangle around pivot. Pixels reach half a pixel out of the
+	// template, and bilinear interpolation another half.
+	float left  = (-1.0F - pivot.x) * scale[0], right  = (size.width  - pivot.x) * scale[2];
+	float top   = (-1.0F - pivot.y) * scale[1], bottom = (size.height - pivot.y) * scale[3];
+	if(mirror)
+	{
+		std::swap(left, right);
+		left  = -left;
+		right = -right;
+	}
 
-	for(int r = rect.y, r_end = rect.y + rect.height; r < r_end; ++r)
-	for(int c = rect.x, c_end = rect.x + rect.width;  c < c_end; ++c)
+	const float c = std::cos(angle), s = std::sin(angle);
+	const Point2f corners[4] = { Point2f(left, top), Point2f(right, top), Point2f(left, bottom), Point2f(right, bottom) };
+	constexpr float MAX = std::numeric_limits<float>::max();
+	float x_min = MAX, y_min = MAX, x_max = -MAX, y_max = -MAX;
+	for(const Point2f& corner: corners)
 	{
-		const int src_r = r - rect.y, src_c = c - rect.x;
-		Point2i mask_position(src_c - offset_x, src_r - offset_y);
-		if(!rect_mask.contains(mask_position) || mask.at<uint8_t>(mask_position) == 0)
-			continue;
+		const float x = position.x + c * corner.x - s * corner.y;
+		const float y = position.y + s * corner.x + c * corner.y;
+		x_min = std::min(x_min, x);  x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);  y_max = std::max(y_max, y);
+	}
 
-		switch(dst.type())
-		{
-		case CV_8UC3:
-		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(src_r, src_c);
-			cv::Vec3b& dst_color = result.at<cv::Vec3b>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3b*>(&src_color), src_color[3]/255.0F * amount);
-		}
-			break;
-		case CV_8UC4:
+	return Rect(Point(cvFloor(x_min), cvFloor(y_min)), Point(cvCeil(x_max) + 1, cvCeil(y_max) + 1));
+}
+
+/**
+ * Sample a row of destination pixels from @p image through the inverse of @p mapping, with bilinear interpolation
+ * in 8 bits fixed point. Pixels out of @p image are 0.
+ *
+ * @param[out] dst      Sampled pixels, with the same channel count of @p image.
+ * @param[in]  image    CV_8UC4 or CV_8UC1 template.
+ * @param[in]  mapping  Mapping from @p image to destination image.
+ * @param[in]  x, y     Position of the first pixel on destination image.
+ * @param[in]  length   Number of pixels.
+ */
+static void sampleRow(uint8_t* dst, const cv::Mat& image, const Makeup::Mapping& mapping, int x, int y, int length)
+{
+	const int channel = image.channels();
+	const int cols = image.cols, rows = image.rows;
+	const float c = std::cos(mapping.angle), s = std::sin(mapping.angle);
+	const Vec4f& scale = mapping.scale;
+	const float inverse[4] = { 1.0F/scale[0], 1.0F/scale[1], 1.0F/scale[2], 1.0F/scale[3] };
+
+	// rotate back, and the row is a straight line on template side.
+	const float dx = x - mapping.position.x, dy = y - mapping.position.y;
+	const float u0 = c * dx + s * dy, v0 = -s * dx + c * dy;
+
+	for(int i = 0; i < length; ++i)
+	{
+		float u = u0 + c * i, v = v0 - s * i;
+		if(mapping.mirror)
+			u = -u;
+		const float sx = mapping.pivot.x + u * (u < 0 ? inverse[0] : inverse[2]);
+		const float sy = mapping.pivot.y + v * (v < 0 ? inverse[1] : inverse[3]);
+
+		uint8_t* d = dst + i * channel;
+		if(!(-1.0F < sx && sx < cols && -1.0F < sy && sy < rows))
 		{
-			const cv::Vec4b& src_color = src.at<cv::Vec4b>(src_r, src_c);
-			cv::Vec4b& dst_color = result.at<cv::Vec4b>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			std::fill(d, d + channel, 0);
+			continue;
 		}
-			break;
-#if 0  // currently unused case
-		case CV_32FC3:
+
+		const int fx = cvFloor(sx * 256), fy = cvFloor(sy * 256);
+		const int x0 = cvFloor(sx), y0 = cvFloor(sy);
+		const int wx = fx - x0 * 256, wy = fy - y0 * 256;
+		const int w00 = (256 - wx) * (256 - wy), w01 = wx * (256 - wy);
+		const int w10 = (256 - wx) * wy,         w11 = wx * wy;
+
+		if(0 <= x0 && x0 + 1 < cols && 0 <= y0 && y0 + 1 < rows)
 		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(src_r, src_c);
-			cv::Vec3f& dst_color = result.at<cv::Vec3f>(r, c);
-			dst_color = mix(dst_color, *reinterpret_cast<const cv::Vec3f*>(&src_color), src_color[3] * amount);
+			const uint8_t* p0 = image.ptr<uint8_t>(y0) + x0 * channel;
+			const uint8_t* p1 = p0 + image.step[0];
+			for(int k = 0; k < channel; ++k)
+				d[k] = static_cast<uint8_t>((p0[k] * w00 + p0[k + channel] * w01 + p1[k] * w10 + p1[k + channel] * w11 + 32768) >> 16);
 		}
-			break;
-		case CV_32FC4:
+		else  // along the border, taps out of image are 0.
 		{
-			const cv::Vec4f& src_color = src.at<cv::Vec4f>(src_r, src_c);
-			cv::Vec4f& dst_color = result.at<cv::Vec4f>(r, c);
-			dst_color = mix(dst_color, src_color, amount);
+			auto tap = [&image, cols, rows, channel](int x, int y, int k) -> int
+			{
+				return (0 <= x && x < cols && 0 <= y && y < rows) ? image.ptr<uint8_t>(y)[x * channel + k] : 0;
+			};
+
+			for(int k = 0; k < channel; ++k)
+				d[k] = static_cast<uint8_t>((tap(x0, y0, k) * w00 + tap(x0 + 1, y0, k) * w01 +
+						tap(x0, y0 + 1, k) * w10 + tap(x0 + 1, y0 + 1, k) * w11 + 32768) >> 16);
 		}
-			break;
+	}
+}
+
+void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Point2i& origin, float amount)
+{
+	assert(!src.empty() && src.type() == CV_8UC4);
+
+	// Note that dst.copyTo(result); will invoke result.create(src.size(), src.type());
+	// which has this clause if( dims <= 2 && rows == _rows && cols == _cols && type() == _type && data ) return;
+	// which means that result's memory will only be allocated the first time in if result is empty.
+	if(dst.data != result.data)
+		dst.copyTo(result);
+
+	blend(result, Layer{src, Mat(), origin, amount}, Rect(0, 0, result.cols, result.rows));
+}
+
+void Makeup::blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount)
+{
+	assert(!src.empty() && src.type() == CV_8UC4);
+	assert(mask.type() == CV_8UC1);
+	if(dst.data != result.data)
+		dst.copyTo(result);
+
+	blend(result, Layer{src, mask, origin, amount}, Rect(0, 0, result.cols, result.rows));
+}
+
+void Makeup::blend(cv::Mat& dst, const cv::Mat& mask, uint32_t color, const cv::Point2i& origin, float amount)
+{
+	assert(mask.type() == CV_8UC1);
+	blend(dst, Layer{mask, Mat(), origin, amount, color}, Rect(0, 0, dst.cols, dst.rows));
+}
+
+void Makeup::blend(cv::Mat& dst, const cv::Mat& cosmetic, const Mapping& mapping, float amount, uint32_t color/* = 0 */)
+{
+	assert(cosmetic.type() == CV_8UC4 || cosmetic.type() == CV_8UC1);
+	blend(dst, Layer{cosmetic, Mat(), Point2i(), amount, color, true, mapping}, Rect(0, 0, dst.cols, dst.rows));
+}
+
+/**
+ * Everything blending a layer needs that doesn't change from row to row, so that a caller can run rows in whatever
+ * way it likes, by a parallel loop or inside tiles which are already parallel.
+ */
+struct LayerBlender
+{
+	const Makeup::Layer& layer;
+	cv::Rect rect;  ///< destination pixels to blend, empty if none
+	cv::Point2i mask_origin;
+	uint8_t table[256];
+	uint8_t color[4];
+
+	LayerBlender(const cv::Mat& dst, const Makeup::Layer& layer, const cv::Rect& clip);
+
+	/**
+	 * Blend row @p r of rect onto @p dst, it's serial.
+	 */
+	void apply(cv::Mat& dst, int r) const;
+};
+
+LayerBlender::LayerBlender(const cv::Mat& dst, const Makeup::Layer& layer, const cv::Rect& clip):
+	layer(layer)
+{
+	const cv::Mat& image = layer.image;
+	const cv::Mat& mask  = layer.mask;
+	assert((image.type() == CV_8UC4 || image.type() == CV_8UC1) && (dst.type() == CV_8UC3 || dst.type() == CV_8UC4));
+	assert(mask.empty() || mask.type() == CV_8UC1);
+
+	const Rect layer_rect = layer.getRect();
+	rect = layer_rect & clip & Rect(0, 0, dst.cols, dst.rows);
+
+	// mask is centered on layer, pixels out of it are left untouched.
+	mask_origin = layer_rect.tl() + Point2i((layer_rect.width - mask.cols)/2, (layer_rect.height - mask.rows)/2);
+	if(!mask.empty())
+		rect &= Rect(mask_origin, mask.size());
+	if(rect.area() <= 0)
+	{
+		rect = Rect();
+		return;
+	}
+
+	createAlphaTable(table, dst.channels(), layer.amount);
+	if(image.channels() == 1)
+	{
+		// Alpha of color is multiplied to coverage like pack() does, fold it into the table.
+		const uint32_t& c = layer.color;
+		const uint32_t alpha = c >> 24;
+		for(int i = 255; i >= 0; --i)  // descending, since (alpha * i + 127)/255 <= i
+			table[i] = table[(alpha * i + 127) / 255];
+
+#if USE_BGRA_LAYOUT
+		color[0] = (c >> 16) & 0xFF;  color[1] = (c >> 8) & 0xFF;  color[2] = c & 0xFF;
+#else
+		color[0] = c & 0xFF;  color[1] = (c >> 8) & 0xFF;  color[2] = (c >> 16) & 0xFF;
 #endif
-		default:
-			assert(false);
-			break;
+		color[3] = alpha;
+	}
+}
+
+void LayerBlender::apply(cv::Mat& dst, int r) const
+{
+	const cv::Mat& image = layer.image;
+	const cv::Mat& mask  = layer.mask;
+	const int channel = dst.channels();
+	const int image_channel = image.channels();
+	const bool is_color = image_channel == 1;
+	const bool has_mask = !mask.empty();
+
+	const uint8_t* mask_row = has_mask ? mask.ptr<uint8_t>(r - mask_origin.y) + (rect.x - mask_origin.x) : nullptr;
+	uint8_t* dst_row = dst.ptr<uint8_t>(r) + rect.x * channel;
+
+	if(!layer.warp)
+	{
+		const uint8_t* src_row = image.ptr<uint8_t>(r - layer.origin.y) + (rect.x - layer.origin.x) * image_channel;
+		if(is_color)
+			blendColorRow(dst_row, channel, color, src_row, mask_row, table, rect.width);
+		else if(layer.premultiplied)
+			blendPremultipliedRow(dst_row, channel, src_row, mask_row, table, rect.width);
+		else
+			blendRow(dst_row, channel, src_row, mask_row, table, rect.width);
+		return;
+	}
+
+	// sample a chunk of the template right before it's blended, so it stays on stack.
+	constexpr int CHUNK = 128;
+	uint8_t sample[CHUNK * 4];
+	for(int i = 0; i < rect.width; i += CHUNK)
+	{
+		const int count = std::min(CHUNK, rect.width - i);
+		const uint8_t* m = has_mask ? mask_row + i : nullptr;
+		sampleRow(sample, image, layer.mapping, rect.x + i, r, count);
+		if(is_color)
+			blendColorRow(dst_row + i * channel, channel, color, sample, m, table, count);
+		else if(layer.premultiplied)
+			blendPremultipliedRow(dst_row + i * channel, channel, sample, m, table, count);
+		else
+			blendRow(dst_row + i * channel, channel, sample, m, table, count);
+	}
+}
+
+void Makeup::blend(cv::Mat& dst, const Layer& layer, const cv::Rect& clip)
+{
+	const LayerBlender blender(dst, layer, clip);
+	const Rect& rect = blender.rect;
+
+	#pragma omp parallel for
+	for(int r = rect.y; r < rect.y + rect.height; ++r)
+		blender.apply(dst, r);
+}
+
+void Makeup::blend(cv::Mat& dst, const std::vector<Layer>& layers)
+{
+	Rect rect;
+	for(const Layer& layer: layers)
+		rect |= layer.getRect();
+	rect &= Rect(0, 0, dst.cols, dst.rows);
+	if(rect.area() <= 0)
+		return;
+
+	// Layers overlap each other, so split by rows rather than by layers. Each tile is small enough to stay in
+	// cache while all the layers are blended onto it in order. Rows of a tile run serially, the tiles are the
+	// parallel part, there is no nested parallel region.
+	constexpr int TILE_HEIGHT = 32;
+	const int tile_count = (rect.height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+	#pragma omp parallel for schedule(dynamic)
+	for(int i = 0; i < tile_count; ++i)
+	{
+		const int top = rect.y + i * TILE_HEIGHT;
+		const Rect tile(rect.x, top, rect.width, std::min(TILE_HEIGHT, rect.y + rect.height - top));
+		for(const Layer& layer: layers)
+		{
+			const LayerBlender blender(dst, layer, tile);
+			for(int r = blender.rect.y; r < blender.rect.y + blender.rect.height; ++r)
+				blender.apply(dst, r);
 		}
 	}
 }
 
-void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points,
-		const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+static std::mutex brow_erase_mutex;
+struct BrowEraseCacheEntry
+{
+	uint64_t key;      ///< fingerprint of method, feature points and pixels in rects
+	cv::Size size;     ///< source image size
+	cv::Rect rects[2]; ///< brow regions with margin, right one first
+	std::vector<Makeup::Layer> layers;
+};
+
+static std::list<BrowEraseCacheEntry> brow_erase_cache;  // most recently used at front
+
+std::vector<Makeup::Layer> Makeup::createBrowEraseLayers(const cv::Mat& src, const std::vector<cv::Point2f>& points,
+		InpaintMethod method/* = InpaintMethod::INTERPOLATION */)
 {
 	assert(src.type() == CV_8UC4 && points.size() == Feature::COUNT);
-	assert(brow.type() == CV_8UC1 || brow.type() == CV_8UC4);
-	if(src.data != dst.data)
-		src.copyTo(dst);
 
-	Feature feature(src, points);
-	Vec4f line = feature.getSymmetryAxis();
+	Vec4f line = Feature::getSymmetryAxis(points);
 	float angle = std::atan2(line[1], line[0]) - static_cast<float>(M_PI/2);
-//	std::cout << __FUNCTION__ << " angle: " << rad2deg(angle) << '\n';
 	float cosa = std::abs(std::cos(angle));
 
-	const bool is_mask = brow.channels() == 1;
-	Mat makeup_mask = is_mask ? brow : splitAlpha(brow);
-	// If mask image is not so good (transparent with value close to 0), you can allow some tolerance here.
-	const Rect2i makeup_rect = Region::boundingRect(makeup_mask, 4/* tolerance */);
-
-	// centroid @see http://docs.opencv.org/2.4/doc/tutorials/imgproc/shapedescriptors/moments/moments.html
-	Moments makeup_moment = cv::moments(makeup_mask);
-	Point2f makeup_center(static_cast<float>(makeup_moment.m10 / makeup_moment.m00),
-	                      static_cast<float>(makeup_moment.m01 / makeup_moment.m00));
-
 	const bool has_alpha = src.channels() > 3;
 
+	std::vector<Point2f> polygons[2];
+	Rect rects[2];
+	int offsets[2];
 	for(int i = 0; i < 2; ++i)
 	{
 		const bool right = (i == 0);
-		std::vector<Point2f> polygon = Feature::calculateBrowPolygon(points, right);
-		Moments moment = cv::moments(polygon);
-		const Point2f center(static_cast<float>(moment.m10 / moment.m00),
-			                 static_cast<float>(moment.m01 / moment.m00));
+		polygons[i] = Feature::calculateBrowPolygon(points, right);
 
-		const Rect rect = cv::boundingRect(polygon);
-		Rect rect_with_margin = rect;
-		int offset = cvRound(rect.height / cosa);
-		Region::inset(rect_with_margin, -offset);
+		const Rect rect = cv::boundingRect(polygons[i]);
+		offsets[i] = cvRound(rect.height / cosa);
+		rects[i] = rect;
+		Region::inset(rects[i], -offsets[i]);
+	}
 
-		Mat roi = dst(rect_with_margin).clone();
+	// Erasing depends only on the face, namely feature points and pixels around the brows, which are cheap to
+	// hash, so switching brow styles, colors or amounts reuses it. Like Cosmetic::get(), a hit must match image size
+	// and regions too, not the hash alone.
+	uint64_t key = fingerprint(&method, sizeof(method));
+	key = fingerprint(points.data(), points.size() * sizeof(Point2f), key);
+	for(int i = 0; i < 2; ++i)
+		key = fingerprint(src(rects[i]), key);
+	{
+		std::lock_guard<std::mutex> lock(brow_erase_mutex);
+		for(auto it = brow_erase_cache.begin(); it != brow_erase_cache.end(); ++it)
+			if(it->key == key && it->size == src.size() && it->rects[0] == rects[0] && it->rects[1] == rects[1])
+			{
+				brow_erase_cache.splice(brow_erase_cache.begin(), brow_erase_cache, it);
+				return brow_erase_cache.front().layers;
+			}
+	}
+
+	std::vector<Layer> layers;
+	for(int i = 0; i < 2; ++i)
+	{
+		const bool right = (i == 0);
+		const std::vector<Point2f>& polygon = polygons[i];
+		const Rect& rect_with_margin = rects[i];
+		const int offset = offsets[i];
+
+		Mat roi = src(rect_with_margin).clone();
 		if(has_alpha)
 			cv::cvtColor(roi, roi, COLOR_RGBA2RGB);  // or COLOR_BGRA2BGR, just strip alpha.
 		Mat roi_mask = Feature::createMask(polygon);
 
 		Mat target_mask(rect_with_margin.height, rect_with_margin.width, CV_8UC1, Scalar::all(0));
 		roi_mask.copyTo(target_mask(Rect(offset, offset, roi_mask.cols, roi_mask.rows)));
-		Region::grow(target_mask, target_mask, offset/4);
 
-#if(USE_INPAINTING == 0)
+		// One distance field serves both the grown mask to be erased, and the feathered mask to blend it back.
+		Mat distance;
+		Region::distanceField(distance, target_mask);
+		Region::feather(target_mask, distance, static_cast<float>(offset/4), 0.0F);
+
 		// TODO related to feature points, better move it to Feature class.
 		int bottom = cvRound(points[right?33:32].y - rect_with_margin.y);
 		if(bottom > target_mask.rows - 1)
 			bottom = target_mask.rows - 1;
 
-		#pragma omp parallel for
-		for(int c = 0; c < target_mask.cols; ++c)
-		{
-			int r0 = 0;
-			while(r0 < target_mask.rows && target_mask.at<uint8_t>(r0, c) == 0)
-				++r0;
-			if(r0 >= target_mask.rows)
-				continue;
+		// Pixels below the top of eye are not skin, don't copy from there.
+		Mat source_mask = (target_mask == 0);
+		if(bottom + 1 < source_mask.rows)
+			source_mask.rowRange(bottom + 1, source_mask.rows).setTo(0);
 
-			int r1 = r0;
-			while(r1 < target_mask.rows && target_mask.at<uint8_t>(r1, c) != 0)
-				++r1;
+		// TODO, make radius self-adaptive, or tune it for a fine result.
+		venus::inpaint(roi, target_mask, method, std::max(offset/4, 1), source_mask);
 
-			for(int r = r0; r < r1; ++r)
-			{
-				int r0_outter = r0 * 2 - r;
-				if(r0_outter < 0)
-					r0_outter = 0;
+		// Fade out towards the grown edge, which used to be 3 passes of Gaussian blur on target_mask.
+		const float feather_radius = offset/8.0F;
+		Region::feather(target_mask, distance, feather_radius, feather_radius);
+//		cv::imshow("roi" + std::to_string(i), roi);
+//		cv::imshow("target_mask", target_mask);
 
-				int r1_outter = r1 * 2 - r;
-				if(r1_outter > bottom)
-					r1_outter = bottom;
+		// Erased brow goes back through the feathered mask, this keeps alpha channel untouched, and mixing
+		// seems better than just overwriting.
+		layers.push_back(Layer{venus::merge(roi, target_mask), Mat(), rect_with_margin.tl(), 1.0F});
+	}
 
-				float weight = static_cast<float>(r - r0)/(r1 - r0);
-				weight = smoothStep(0.42F, 0.78F, weight);  // prefer to use skin of eyes above than below.
-				roi.at<Vec3b>(r, c) = mix(roi.at<Vec3b>(r0_outter, c), roi.at<Vec3b>(r1_outter, c), weight);
-			}
-		}
+	constexpr size_t CAPACITY = 4;  // faces
+	std::lock_guard<std::mutex> lock(brow_erase_mutex);
+	brow_erase_cache.push_front(BrowEraseCacheEntry{key, src.size(), {rects[0], rects[1]}, layers});
+	if(brow_erase_cache.size() > CAPACITY)
+		brow_erase_cache.pop_back();
 
-#elif(USE_INPAINTING == 1)  // OpenCV's inpainting algorithm
-		constexpr double inpaint_radius = offset/4;  // TODO, make it self-adaptive, or tune it for a fine result.
-
-		// tested with Navier-Stokes algorithm and A. Telea algorithm, and no obvious difference found.
-		cv::inpaint(roi, target_mask, roi, inpaint_radius, cv::INPAINT_TELEA);
-#elif(USE_INPAINTING == 2)  // Criminisi's inpainting algorithm
-		Mat source_mask;
-		cv::bitwise_not(target_mask, source_mask);
-
-		Inpainter inpainter;
-		inpainter.setSourceImage(roi);
-		inpainter.setSourceMask(source_mask);
-		inpainter.setTargetMask(target_mask);
-		inpainter.setPatchSize(8);
-		inpainter.initialize();
-	
-		while(inpainter.hasMoreSteps())
-			inpainter.step();
-		Mat inpaint_image = inpainter.image();
-		inpaint_image.copyTo(roi);
-#else
-#error "invalid macro integer"
-#endif /* USE_INPAINTING */
+	return layers;
+}
 
-//		target_mask.convertTo(target_mask, target_mask.depth(), 1.0F);
-		for(int k = 0; k < 3; ++k)
-			venus::gaussianBlur(target_mask, target_mask, offset/4.0F);
-//		cv::imshow("roi" + std::to_string(i), roi);
-//		cv::imshow("target_mask", target_mask);
-		
-#if 1
-		// This branch will overwrite alpha channel value if @p src is not opaque(255).
-		if(has_alpha)
-			cv::cvtColor(roi, roi, COLOR_RGB2RGBA);  // recover alpha with full value(255).
-		roi.copyTo(dst(rect_with_margin), target_mask);
-#else
-		// This branch keeps alpha channel untouched, so it's preferable.
-		for(int r = 0; r < rect.height; ++r)
-		for(int c = 0; c < rect.width;  ++c)
-		{
-			uint8_t alpha = target_mask.at<uint8_t>(r + offset, c + offset);
-			if(alpha == 0)  // shortcut
-				continue;
+std::vector<Makeup::Layer> Makeup::createBrowLayers(const std::vector<cv::Point2f>& points,
+		const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+{
+	assert(points.size() == Feature::COUNT);
+	assert(brow.type() == CV_8UC1 || brow.type() == CV_8UC4);
 
-			const cv::Vec3b& src_color = roi.at<cv::Vec3b>(r, c);
-			cv::Vec4b& dst_color = dst.at<cv::Vec4b>(r + rect.y, c + rect.x);
+	Vec4f line = Feature::getSymmetryAxis(points);
+	float angle = std::atan2(line[1], line[0]) - static_cast<float>(M_PI/2);
+//	std::cout << __FUNCTION__ << " angle: " << rad2deg(angle) << '\n';
 
-//			*reinterpret_cast<cv::Vec3b*>(&dst_color) = src_color;
-			// mixing(below) seems better than just overwriting(above).
-			uint8_t* p = reinterpret_cast<uint8_t*>(&dst_color);
-			p[0] = lerp(p[0], src_color[0], alpha);
-			p[1] = lerp(p[1], src_color[1], alpha);
-			p[2] = lerp(p[2], src_color[2], alpha);
-		}
-#endif
+	const bool is_mask = brow.channels() == 1;
+	Mat makeup_mask = is_mask ? brow : splitAlpha(brow);
+	// If mask image is not so good (transparent with value close to 0), you can allow some tolerance here.
+	const Rect2i makeup_rect = Region::boundingRect(makeup_mask, 4/* tolerance */);
 
-		if(!right)  // mirror image for left side
-		{
-			cv::flip(makeup_mask, makeup_mask, 1/* horizontal */);
-			makeup_center.x = makeup_rect.width - makeup_center.x;
-		}
+	// centroid @see http://docs.opencv.org/2.4/doc/tutorials/imgproc/shapedescriptors/moments/moments.html
+	Moments makeup_moment = cv::moments(makeup_mask);
+	const Point2f makeup_center(static_cast<float>(makeup_moment.m10 / makeup_moment.m00),
+	                            static_cast<float>(makeup_moment.m01 / makeup_moment.m00));
 
-		Vec2f scale(static_cast<float>(rect.width) / makeup_rect.width,
-		            static_cast<float>(rect.height)/ makeup_rect.height);
-		Size target_size = makeup_rect.size();
-		Point2f target_center = makeup_center;
-		Mat affine = Region::transform(target_size, target_center, angle, scale);
-		cv::Mat affined_mask;
-		cv::warpAffine(makeup_mask, affined_mask, affine, target_size, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
-		Mat affined_brow = is_mask ? Makeup::pack(affined_mask, color) : brow;
+	const std::shared_ptr<const Cosmetic> cosmetic = Cosmetic::get(brow);
+
+	std::vector<Layer> layers;
+	for(int i = 0; i < 2; ++i)
+	{
+		const bool right = (i == 0);
+		std::vector<Point2f> polygon = Feature::calculateBrowPolygon(points, right);
+		Moments moment = cv::moments(polygon);
+		const Point2f center(static_cast<float>(moment.m10 / moment.m00),
+			                 static_cast<float>(moment.m01 / moment.m00));
+		const Rect rect = cv::boundingRect(polygon);
+
+		const float scale_x = static_cast<float>(rect.width) / makeup_rect.width;
+		const float scale_y = static_cast<float>(rect.height)/ makeup_rect.height;
 
 		// need to move X coordinate with respect to the 1/slant.
 		Point2f translation(offsetY/line[1] * line[0], offsetY);
-		Point2f origin = center - target_center + translation;
-		Makeup::blend(dst, dst, affined_brow, origin, amount);
+
+		// The brow is sampled straight from the template while blending, left side is mirrored.
+		Mapping mapping{makeup_center, center + translation, Vec4f(scale_x, scale_y, scale_x, scale_y), angle, !right};
+		layers.push_back(cosmetic->createLayer(mapping, amount, color));
 	}
+
+	return layers;
 }
 
-void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount)
+void Makeup::applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points,
+		const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */,
+		InpaintMethod method/* = InpaintMethod::INTERPOLATION */)
 {
-	assert(src.type() == CV_8UC4 && cosmetic.type() == CV_8UC4);
+	std::vector<Layer> layers = createBrowEraseLayers(src, points, method);
+	std::vector<Layer> brows = createBrowLayers(points, brow, color, amount, offsetY);
+	layers.insert(layers.end(), brows.begin(), brows.end());
+
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	blend(dst, layers);
+}
+
+std::vector<Makeup::Layer> Makeup::createEyeLayers(const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic,
+		float amount, uint32_t color/* = 0 */)
+{
+	assert(points.size() == Feature::COUNT && (cosmetic.type() == CV_8UC4 || cosmetic.type() == CV_8UC1));
+	std::vector<Layer> layers;
+	const std::shared_ptr<const Cosmetic> asset = Cosmetic::get(cosmetic);
+
 /*
 	Below are eye feature point indices:
 
@@ -547,7 +827,7 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 		return Vec4f(pivot.x, pivot.y, radius, angle);
 	};
 
-	const Vec4f PARAMS = calculateEyeParams(src_points[0], src_points[4]);
+	const float RADIUS = calculateEyeParams(src_points[0], src_points[4])[2];
 
 	for(int j = 0; j < 2; ++j)
 	{
@@ -567,9 +847,17 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 		}
 
 		Vec4f params = calculateEyeParams(dst_points[0], dst_points[4]);
-		printf("pivot: (%f, %f), radius: %f, angle: %f\n", params[0], params[1], params[2], rad2deg(params[3]));
+//		std::cout << "pivot: " << params[0] << ", " << params[1] << " radius: " << params[2] << " angle: " << rad2deg(params[3]) << '\n';
 
-		Size size(cosmetic.cols, cosmetic.rows);
+		// Work on the level no smaller than the scaled cosmetic, which is prefiltered, so bilinear is enough.
+		const int level = asset->selectLevel(params[2]/RADIUS);
+		const Mat& level_cosmetic = asset->getLevel(level);
+		std::vector<Point2f> level_points(N);
+		for(int i = 0; i < N; ++i)
+			level_points[i] = asset->mapToLevel(src_points[i], level);
+		const Vec4f PARAMS = calculateEyeParams(level_points[0], level_points[4]);
+
+		Size size(level_cosmetic.cols, level_cosmetic.rows);
 		Point2f pivot(PARAMS[0], PARAMS[1]);
 		float angle = params[3];
 		float scale = params[2]/PARAMS[2];
@@ -577,10 +865,10 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 		Mat affine = Region::transform(size, pivot, angle, Point2f(scale, scale));
 
 		cv::Mat _cosmetic;
-		cv::warpAffine(cosmetic, _cosmetic, affine, size, cv::INTER_LANCZOS4, cv::BORDER_CONSTANT);
+		cv::warpAffine(level_cosmetic, _cosmetic, affine, size, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
 		
 		std::vector<Point2f> affined_src_points;
-		cv::transform(src_points, affined_src_points, affine);
+		cv::transform(level_points, affined_src_points, affine);
 		pivot = Region::transform(affine, Point2f(PARAMS[0], PARAMS[1]));
 
 		// and then move points to make src_points and dst_points' pivots coincide.
@@ -597,65 +885,76 @@ void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Po
 		_cosmetic = warp.genNewImage(_cosmetic, 1.0F);
 //		cv::imshow("test" + std::to_string(j), _cosmetic);
 
-		if(!right)
+		// The rotation/scaling and moving least squares warp above still make two copies of the template, since the
+		// warp works on the affined image and can't be folded into a Mapping. Mirroring the left one though is
+		// done while blending instead of by another copy. Pivot and position are integers, so that sampling hits
+		// pixel centers and is as sharp as a flip.
+		if(right)
 		{
-			// NOTICE the -1 here, since left(0) + right(cols - 1) == cols - 1.
-			pivot.x = static_cast<float>(_cosmetic.cols - 1) - pivot.x;
-			cv::flip(_cosmetic, _cosmetic, 1/* horizontally */);
+			const Point2i origin = dst_pivot - pivot;
+			layers.push_back(Layer{_cosmetic, Mat(), origin, amount, color, false, Mapping(), asset->isPremultiplied()});
+		}
+		else
+		{
+			const Point2f template_pivot(static_cast<float>(cvRound(pivot.x)), static_cast<float>(cvRound(pivot.y)));
+			const Point2f position(static_cast<float>(cvRound(dst_pivot.x)), static_cast<float>(cvRound(dst_pivot.y)));
+			const Mapping mapping{template_pivot, position, Vec4f(1.0F, 1.0F, 1.0F, 1.0F), 0.0F, true};
+			layers.push_back(Layer{_cosmetic, Mat(), Point2i(), amount, color, true, mapping, asset->isPremultiplied()});
 		}
-		Point2i origin = dst_pivot - pivot;
-
-		Makeup::blend(dst, dst, _cosmetic, origin, amount);
 	}
 #else
 	const Point2f LEFT(284, 287), RIGHT(633, 287);
 	const Point2f TOP(458, 213), BOTTOM(458, 362);
-	Point2f PIVOT, pivot;
+	Point2f PIVOT;
 	Vec4f DISTANCE = Feature::calculateDistance(PIVOT, LEFT, TOP, RIGHT, BOTTOM);
 
-	Feature feature(src, points);
+	const Vec4f line = Feature::getSymmetryAxis(points);
+	const float angle = std::atan2(line[1], line[0]) - static_cast<float>(M_PI/2);
 
 	for(int i = 0; i <= 1; ++i)
 	{
 		const bool is_right = (i == 0);
-		Vec4f distance = feature.calculateEyeRadius(is_right);
+		Vec4f distance = Feature::calculateEyeRadius(points, line, is_right);
 
 		Vec4f scale;
 		for(int i = 0; i < 4; ++i)  // sighs, no operator / overloaded for Vec4f.
 			scale[i] = distance[i] / DISTANCE[i];
 //		std::cout << "scale factor left: " << scale[0] << " top: " << scale[1] << " right: " << scale[2] << " bottom: " << scale[3] << '\n';
 
-		Mat _cosmetic = cosmetic;
-
-		if(!is_right)  // mirror for left part
-		{
-			std::swap(scale[0], scale[2]);  // std::swap(left, right);
-			PIVOT.x = static_cast<float>(cosmetic.cols - 1) - PIVOT.x;  // left + right == width - 1
-			cv::flip(_cosmetic, _cosmetic, 1/* horizontally */);
-		}
-
-		// use INTER_LANCZOS4 instead of INTER_LINEAR for best anti-aliasing result
-		_cosmetic = Region::resize(_cosmetic, PIVOT, scale, INTER_LANCZOS4);
-
-		// make pivot coincides
-		Region region = feature.calculateEyeRegion(is_right);
+		// Place the scaled cosmetic at the center of eye region, left part mirrored. Instead of flipping and
+		// resizing the cosmetic, it's sampled straight from the template while blending.
+		Region region = Feature::calculateEyeRegion(points, line, is_right);
 		Rect rect = region.getRect();
-		Point2f position(rect.x - (_cosmetic.cols - rect.width )/2.0F,
-			             rect.y - (_cosmetic.rows - rect.height)/2.0F);
-
-		// rotate if skew too much
+		const float left  = PIVOT.x * scale[0], right = (cosmetic.cols - PIVOT.x) * scale[2];
+		const float width = left + right, height = PIVOT.y * scale[1] + (cosmetic.rows - PIVOT.y) * scale[3];
+		Point2f position(rect.x + (rect.width  - width )/2.0F + (is_right ? left : right),
+		                 rect.y + (rect.height - height)/2.0F + PIVOT.y * scale[1]);
 
-		Makeup::blend(dst, dst, _cosmetic, position, amount);
+		Mapping mapping{PIVOT, position, scale, angle, !is_right};
+		layers.push_back(asset->createLayer(mapping, amount, color));
 	}
 #endif
+
+	return layers;
+}
+
+void Makeup::applyEye(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic, float amount)
+{
+	assert(src.type() == CV_8UC4 && cosmetic.type() == CV_8UC4);
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	blend(dst, createEyeLayers(points, cosmetic, amount));
 }
 
 void Makeup::applyEyeLash(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
 {
-	assert(mask.type() == CV_8UC1);
-	Mat eye_lash = pack(mask, color);
+	assert(src.type() == CV_8UC4 && mask.type() == CV_8UC1);
+	if(src.data != dst.data)
+		src.copyTo(dst);
 
-	applyEye(dst, src, points, eye_lash, amount);
+	// warp the mask only and fill it with color when blending, instead of warping a packed RGBA image.
+	blend(dst, createEyeLayers(points, mask, amount, color));
 }
 
 cv::Mat Makeup::createEyeShadow(cv::Mat mask[3], uint32_t color[3]/*, const int& COUNT = 3 */)
@@ -708,35 +1007,19 @@ void Makeup::applyEyeShadow(cv::Mat& dst, const cv::Mat& src, const std::vector<
 	applyEye(dst, src, points, eye_shadow, amount);
 }
 
-void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount)
+std::vector<Makeup::Layer> Makeup::createIrisLayers(const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount)
 {
 	assert(0 <= amount && amount <= 1.0F);
-	if(src.data != dst.data)
-		src.copyTo(dst);
-
-	cv::Mat mask2 = mask.clone();
-	if(mask2.channels() == 3)
-		cvtColor(mask2, mask2, COLOR_BGR2BGRA);
-	mask2.convertTo(mask2, CV_32FC4, 1/255.0);
-
-	const Vec3f FROM_COLOR(1.0F, 1.0F, 1.0F);  // white
-	const int length = mask.rows * mask.cols;
-	float* mask2_data = mask2.ptr<float>();
-	const float* from = &FROM_COLOR[0];
 
-	#pragma omp parallel for
-	for(int i = 0; i < length; ++i)
-	{
-		float* p = mask2_data + (i<<2);
-		color2alpha(from, p, p);
-	}
-	mask2.convertTo(mask2, CV_8UC4, 255.0);
-//	cv::imwrite("color2alpha.png", mask2);
+	// white turned into transparency once, and cached.
+	const std::shared_ptr<const Cosmetic> iris = Cosmetic::get(mask, Cosmetic::Kind::IRIS);
+	const Point2f mask_center((mask.cols - 1) / 2.0F, (mask.rows - 1) / 2.0F);
 
 	float mask_radius = mask.rows / 2.0F;
 	amount = 1.2F * amount + 1.0F;  // [0, 1] => [1, 1.2]  interval can be tweaked.
 	
-	Feature feature(src, points);
+	const Vec4f line = Feature::getSymmetryAxis(points);
+	std::vector<Layer> layers;
 	for(int i = 0; i < 2; ++i)
 	{
 		const bool is_right = i == 0;
@@ -744,24 +1027,31 @@ void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::P
 		const cv::Point2f& center = iris_info.first;
 		const float& radius = iris_info.second;
 
-		Mat iris;
 		float scale = radius / mask_radius * amount;
-		cv::resize(mask2, iris, Size(/*radius, radius*/), scale, scale, cv::INTER_LINEAR);
+		Mapping mapping{mask_center, center, Vec4f(scale, scale, scale, scale), 0.0F, false};
 
-		Point2i origin = center - Point2f(iris.cols, iris.rows)/2;
-		Region region = feature.calculateEyeRegion(is_right);
-		Makeup::blend(dst, dst, iris, region.mask, origin, 1.0F);
+		Layer layer = iris->createLayer(mapping, 1.0F);
+		layer.mask = Feature::calculateEyeRegion(points, line, is_right).mask;
+		layers.push_back(layer);
 	}
+
+	return layers;
 }
 
-void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
+void Makeup::applyIris(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount)
 {
-	assert(!src.empty() && points.size() == Feature::COUNT);
-	assert(0.0F <= amount && amount <= 1.0F);
-
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	blend(dst, createIrisLayers(points, mask, amount));
+}
+
+std::vector<Makeup::Layer> Makeup::createBlushLayers(const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
+{
+	assert(points.size() == Feature::COUNT);
+	assert(0.0F <= amount && amount <= 1.0F);
+
+	std::vector<Layer> layers;
 	for(int i = 0; i < 2; ++i)
 	{
 		// static_cast<bool>(i) emits warning "C4800: 'int' : forcing value to bool 'true' or 'false' (performance warning)".
@@ -771,24 +1061,31 @@ void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::
 
 		Rect rect = cv::boundingRect(polygon);
 		Mat  mask = Feature::maskPolygonSmooth(rect, polygon, 8);  // level (here 8) can be tuned.
-		Mat blush = pack(mask, color);
 //		cv::imshow(std::string("blush mask ") + (i == 0 ? "right":"left"), mask);
-		blend(dst, dst, blush, rect.tl(), amount);
+		layers.push_back(Layer{mask, Mat(), rect.tl(), amount, color});
 
 		if(shape == BlushShape::SEAGULL)  // apply seagull shape in one go
 			break;
 	}
+
+	return layers;
 }
 
-void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
+void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount)
 {
-	assert(!src.empty() && points.size() == Feature::COUNT);
-	assert(!mask.empty() && mask.type() == CV_8UC1);  // In fact, relaxing CV_8UC1 restriction can be achieved by Effect::grayscale()
-	assert(0.0F <= amount && amount <= 1.0F);
-
+	assert(!src.empty());
 	if(src.data != dst.data)
 		src.copyTo(dst);
 
+	blend(dst, createBlushLayers(points, shape, color, amount));
+}
+
+std::vector<Makeup::Layer> Makeup::createBlushLayers(const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
+{
+	assert(points.size() == Feature::COUNT);
+	assert(!mask.empty() && mask.type() == CV_8UC1);  // In fact, relaxing CV_8UC1 restriction can be achieved by Effect::grayscale()
+	assert(0.0F <= amount && amount <= 1.0F);
+
 	constexpr bool crop_margin = false;  // enable this variable if you want to crop transparent margin
 	Mat mask2 = crop_margin? mask(Region::boundingRect(mask, 0/* tolerance */)): mask;
 //	mask2 = Effect::grayscale(mask2);  // relaxation can be done here.
@@ -799,6 +1096,7 @@ void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::
 	const bool is_square_shape = mask.rows == mask.cols;
 
 	RotatedRect rotated_rect;
+	std::vector<Layer> layers;
 	for(int i = 0; i < 2; ++i)
 	{
 		const bool is_right = i == 0;
@@ -842,38 +1140,43 @@ void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::
 			cv::flip(mask2, mask2, 1/* horizontal */);
 
 		Point2i origin = rotated_rect.center - center;
-		Mat blush = pack(affined_mask, color);
-		blend(dst, dst, blush, origin, amount);
+		layers.push_back(Layer{affined_mask, Mat(), origin, amount, color});
 	}
+
+	return layers;
 }
 
-void Makeup::applyLip(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, uint32_t color, float amount)
+void Makeup::applyBlush(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount)
 {
-	assert(!src.empty() && src.channels() == 4);  // only handles RGBA image
+	assert(!src.empty());
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	blend(dst, createBlushLayers(points, mask, color, amount));
+}
 
-	Feature feature(src, points);
-	Region region = feature.calculateLipsRegion();
+std::vector<Makeup::Layer> Makeup::createLipLayers(const std::vector<cv::Point2f>& points, uint32_t color, float amount)
+{
+	assert(points.size() == Feature::COUNT);
+
+	Region region = Feature::calculateLipsRegion(points, Feature::getSymmetryAxis(points));
 	const Mat& mask = region.mask;
 	const Point2f& pivot = region.pivot;
-	const int& rows = mask.rows, &cols = mask.cols;
 	const Point2i& origin = pivot - static_cast<Point2f>(Point2i(mask.cols, mask.rows))/2;
-	
-/*
-	Rect all(0, 0, src.cols, src.rows);
-	Rect lip(origin.x, origin.y, rows, cols);
-	const Rect rect = all & lip;
-	
-	if(rect.area() <= 0)  // not overlap
-		return;
-*/
-	cv::Mat lip(rows, cols, CV_8UC4, Scalar::all(0));
-	uint32_t* lip_data = reinterpret_cast<uint32_t*>(lip.data);
-	for(int i = 0, length = rows * cols; i < length; ++i)
-		lip_data[i] = color;
 
-#if 1
-	blend(dst, src, lip, mask, origin, amount);
-#else
+	// lip mask is binary, so it works as coverage of color, no need to fill a bitmap with color.
+	return std::vector<Layer>{ Layer{mask, Mat(), origin, amount, color} };
+}
+
+void Makeup::applyLip(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points, uint32_t color, float amount)
+{
+	assert(!src.empty() && src.channels() == 4);  // only handles RGBA image
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	blend(dst, createLipLayers(points, color, amount));
+
+#if 0
 	// SRC_OVER mode, [Sa + (1 - Sa)*Da, Rc = Sc + (1 - Sa)*Dc]
 	const float l_amount = 1 - amount;
 	if(src.type() == CV_8UC4)
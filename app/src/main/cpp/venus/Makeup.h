@@ -5,6 +5,7 @@
 
 #include <opencv2/core.hpp>
 
+#include "venus/inpaint.h"
 #include "venus/Region.h"
 
 namespace venus {
@@ -25,6 +26,46 @@ public:
 		SHAPE_COUNT  // for internal use only, must be last - used to validate shape type
 	};
 
+	/**
+	 * Maps a cosmetic template onto the destination image: scale the four parts around @p pivot separately like
+	 * Region::resize() does, mirror it horizontally if asked, rotate it about @p pivot like Region::transform()
+	 * does, and finally move @p pivot to @p position.
+	 */
+	struct Mapping
+	{
+		cv::Point2f pivot;     ///< Pivot on the template.
+		cv::Point2f position;  ///< Where @p pivot goes on the destination image.
+		cv::Vec4f   scale;     ///< Scaling factors of the left, top, right and bottom parts of the template, all positive.
+		float       angle;     ///< Angle in radians, positive value means clockwise rotation.
+		bool        mirror;    ///< Flip the template horizontally after scaling.
+
+		/**
+		 * @param[in] size Size of the template.
+		 * @return Bounding rectangle of the mapped template on the destination image.
+		 */
+		cv::Rect getRect(const cv::Size& size) const;
+	};
+
+	/**
+	 * A cosmetic image placed on the destination image. The create*Layers() functions do all the geometry work
+	 * and leave the final blending to blend(), so that several cosmetics can be composited in one pass.
+	 *
+	 * @see MakeupLook
+	 */
+	struct Layer
+	{
+		cv::Mat     image;   ///< CV_8UC4 cosmetic whose alpha channel tells the coverage, or CV_8UC1 coverage of @p color.
+		cv::Mat     mask;    ///< Optional CV_8UC1 mask centered on getRect(), pixels of value 0 are left untouched.
+		cv::Point2i origin;  ///< Position of @p image's top left corner on the destination image, unless @p warp.
+		float       amount;  ///< Blending amount in range [0, 1], 0 being no effect, 1 being fully applied.
+		uint32_t    color;   ///< 0xAABBGGRR, only used if @p image is CV_8UC1, @see pack().
+		bool        warp;    ///< Sample @p image through @p mapping while blending, instead of placing it at @p origin.
+		Mapping     mapping;
+		bool        premultiplied;  ///< RGB of CV_8UC4 @p image is premultiplied by alpha, @see Cosmetic.
+
+		cv::Rect getRect() const { return warp ? mapping.getRect(image.size()) : cv::Rect(origin.x, origin.y, image.cols, image.rows); }
+	};
+
 private:
 
 	static std::vector<cv::Point2f> createPolygon(const std::vector<cv::Point2f>& points, BlushShape shape, bool right);
@@ -57,6 +98,73 @@ public:
 	static void blend(cv::Mat& result, const cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, const cv::Point2i& origin, float amount);
 	/**@}*/
 
+	/**
+	 * Composite a constant color through a mask onto @p dst in place. It's the same as
+	 * <code>blend(dst, dst, pack(mask, color), origin, amount);</code> but allocates nothing.
+	 *
+	 * @param[in,out] dst    CV_8UC3 or CV_8UC4 image.
+	 * @param[in]     mask   CV_8UC1 coverage of color.
+	 * @param[in]     color  0xAABBGGRR, alpha will be multiplied to @p mask.
+	 * @param[in]     origin Relative origin of the <code>mask</code> on <code>dst</code> image.
+	 * @param[in]     amount Blending amount in range [0, 1], 0 being no effect, 1 being fully applied.
+	 */
+	static void blend(cv::Mat& dst, const cv::Mat& mask, uint32_t color, const cv::Point2i& origin, float amount);
+
+	/**
+	 * Warp @p cosmetic and blend it onto @p dst in one pass, each destination pixel samples the template with
+	 * bilinear interpolation, so there is no intermediate resized, rotated or flipped image at all.
+	 *
+	 * @param[in,out] dst      CV_8UC3 or CV_8UC4 image.
+	 * @param[in]     cosmetic CV_8UC4 template, or CV_8UC1 coverage of @p color.
+	 * @param[in]     mapping  Where the template goes.
+	 * @param[in]     amount   Blending amount in range [0, 1], 0 being no effect, 1 being fully applied.
+	 * @param[in]     color    0xAABBGGRR, only used if @p cosmetic is CV_8UC1.
+	 */
+	static void blend(cv::Mat& dst, const cv::Mat& cosmetic, const Mapping& mapping, float amount, uint32_t color = 0);
+
+	/**
+	 * Blend the part of @p layer which lies inside @p clip onto @p dst in place.
+	 *
+	 * @param[in,out] dst    CV_8UC3 or CV_8UC4 image.
+	 * @param[in]     layer  The cosmetic.
+	 * @param[in]     clip   Pixels outside this rectangle are not touched.
+	 */
+	static void blend(cv::Mat& dst, const Layer& layer, const cv::Rect& clip);
+
+	/**
+	 * Composite @p layers in order onto @p dst in place. The work is split into tiles of rows within the
+	 * bounding rectangle of all layers, and each tile is done in parallel.
+	 */
+	static void blend(cv::Mat& dst, const std::vector<Layer>& layers);
+
+	/**
+	 * Calculate layers which erase the original brows of @p src, they should go under the brow layers. They depend
+	 * on the face only, so keep them when switching brow styles, colors or amounts.
+	 *
+	 * @param[in] method  Inpainting algorithm to erase brows, pick a faster one for preview and a finer one for export.
+	 * @see #createBrowLayers
+	 */
+	static std::vector<Layer> createBrowEraseLayers(const cv::Mat& src, const std::vector<cv::Point2f>& points,
+			InpaintMethod method = InpaintMethod::INTERPOLATION);
+
+	/**@{
+	 * Calculate layers of the respective cosmetic without touching any image, parameters are the same as
+	 * the apply*() counterparts. Only Layer::amount and Layer::color of the result depend on the amount and
+	 * color arguments, so they can be changed later without calculating the layers again, except
+	 * createIrisLayers() whose amount is the size of iris.
+	 *
+	 * createEyeLayers() takes either an RGBA @p cosmetic, or a gray one as mask filled with @p color.
+	 */
+	static std::vector<Layer> createBrowLayers(const std::vector<cv::Point2f>& points,
+			const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F);
+	static std::vector<Layer> createEyeLayers(const std::vector<cv::Point2f>& points, const cv::Mat& cosmetic,
+			float amount, uint32_t color = 0);
+	static std::vector<Layer> createIrisLayers(const std::vector<cv::Point2f>& points, const cv::Mat& mask, float amount);
+	static std::vector<Layer> createBlushLayers(const std::vector<cv::Point2f>& points, BlushShape shape, uint32_t color, float amount);
+	static std::vector<Layer> createBlushLayers(const std::vector<cv::Point2f>& points, const cv::Mat& mask, uint32_t color, float amount);
+	static std::vector<Layer> createLipLayers(const std::vector<cv::Point2f>& points, uint32_t color, float amount);
+	/**@}*/
+
 	/**
 	 * @param[out] dst
 	 * @param[in] src     The source image
@@ -66,9 +174,11 @@ public:
 	                      useless if @p brow is colored, and pass value 0 would be fine.
 	 * @param[in] amount  Blending amount in range [0, 1], The larger the value, the thicker/heavier the eyebrow will looks.
 	 * @param[in] offsetY Tweak eye brow's height by pixel, since a litter upper(negative value) or lower(positive value) may look better.
+	 * @param[in] method  Inpainting algorithm to erase the original brows.
 	 */
 	static void applyBrow(cv::Mat& dst, const cv::Mat& src, const std::vector<cv::Point2f>& points,
-			const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F);
+			const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F,
+			InpaintMethod method = InpaintMethod::INTERPOLATION);
 
 	/**
 	 * @param[in] cosmetic makeup about eyes
@@ -0,0 +1,165 @@
+#include "venus/Feature.h"
+#include "venus/MakeupLook.h"
+
+using namespace cv;
+
+namespace venus {
+
+MakeupLook::MakeupLook(const cv::Mat& src, const std::vector<cv::Point2f>& points):
+		src(src),
+		points(points)
+{
+	assert(src.type() == CV_8UC4 && points.size() == Feature::COUNT);
+}
+
+int MakeupLook::add(std::vector<Makeup::Layer>&& layers, size_t fixed/* = 0 */)
+{
+	cosmetics.push_back(Item{std::move(layers), fixed, Mat()});
+	return static_cast<int>(cosmetics.size()) - 1;
+}
+
+int MakeupLook::addBrow(const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */,
+		InpaintMethod method/* = InpaintMethod::INTERPOLATION */)
+{
+	std::vector<Makeup::Layer> layers = Makeup::createBrowEraseLayers(src, points, method);
+	const size_t fixed = layers.size();
+
+	std::vector<Makeup::Layer> brows = Makeup::createBrowLayers(points, brow, color, amount, offsetY);
+	layers.insert(layers.end(), brows.begin(), brows.end());
+	return add(std::move(layers), fixed);
+}
+
+int MakeupLook::addEye(const cv::Mat& cosmetic, float amount)
+{
+	return add(Makeup::createEyeLayers(points, cosmetic, amount));
+}
+
+int MakeupLook::addEyeLash(const cv::Mat& mask, uint32_t color, float amount)
+{
+	assert(mask.type() == CV_8UC1);
+	return add(Makeup::createEyeLayers(points, mask, amount, color));
+}
+
+int MakeupLook::addEyeShadow(cv::Mat mask[3], uint32_t color[3], float amount)
+{
+	return add(Makeup::createEyeLayers(points, Makeup::createEyeShadow(mask, color), amount));
+}
+
+int MakeupLook::addIris(const cv::Mat& mask, float amount)
+{
+	int index = add(Makeup::createIrisLayers(points, mask, amount));
+	cosmetics[index].iris = mask;
+	return index;
+}
+
+int MakeupLook::addBlush(Makeup::BlushShape shape, uint32_t color, float amount)
+{
+	return add(Makeup::createBlushLayers(points, shape, color, amount));
+}
+
+int MakeupLook::addBlush(const cv::Mat& mask, uint32_t color, float amount)
+{
+	return add(Makeup::createBlushLayers(points, mask, color, amount));
+}
+
+int MakeupLook::addLip(uint32_t color, float amount)
+{
+	return add(Makeup::createLipLayers(points, color, amount));
+}
+
+void MakeupLook::setBrow(int index, const cv::Mat& brow, uint32_t color, float amount, float offsetY/* = 0.0F */)
+{
+	assert(0 <= index && index < static_cast<int>(cosmetics.size()));
+	Item& cosmetic = cosmetics[index];
+	assert(cosmetic.fixed > 0);  // added by addBrow()
+
+	std::vector<Makeup::Layer> brows = Makeup::createBrowLayers(points, brow, color, amount, offsetY);
+	cosmetic.layers.resize(cosmetic.fixed);
+	cosmetic.layers.insert(cosmetic.layers.end(), brows.begin(), brows.end());
+}
+
+void MakeupLook::setAmount(int index, float amount)
+{
+	assert(0 <= index && index < static_cast<int>(cosmetics.size()));
+	assert(0 <= amount && amount <= 1.0F);
+	Item& cosmetic = cosmetics[index];
+
+	if(!cosmetic.iris.empty())
+		cosmetic.layers = Makeup::createIrisLayers(points, cosmetic.iris, amount);
+	else
+		for(size_t i = cosmetic.fixed; i < cosmetic.layers.size(); ++i)
+			cosmetic.layers[i].amount = amount;
+}
+
+void MakeupLook::setColor(int index, uint32_t color)
+{
+	assert(0 <= index && index < static_cast<int>(cosmetics.size()));
+	Item& cosmetic = cosmetics[index];
+
+	for(size_t i = cosmetic.fixed; i < cosmetic.layers.size(); ++i)
+		cosmetic.layers[i].color = color;  // only used by CV_8UC1 layers
+}
+
+void MakeupLook::remove(int index)
+{
+	assert(0 <= index && index < static_cast<int>(cosmetics.size()));
+	cosmetics[index].layers.clear();
+	cosmetics[index].fixed = 0;
+	cosmetics[index].iris.release();
+}
+
+void MakeupLook::clear()
+{
+	cosmetics.clear();
+}
+
+cv::Rect MakeupLook::boundingRect() const
+{
+	Rect rect;
+	for(const Item& cosmetic: cosmetics)
+		for(const Makeup::Layer& layer: cosmetic.layers)
+			rect |= layer.getRect();
+
+	return rect & Rect(0, 0, src.cols, src.rows);
+}
+
+void MakeupLook::composite(cv::Mat& dst) const
+{
+	std::vector<Makeup::Layer> layers;
+	for(const Item& cosmetic: cosmetics)
+		layers.insert(layers.end(), cosmetic.layers.begin(), cosmetic.layers.end());
+
+	Makeup::blend(dst, layers);
+}
+
+void MakeupLook::apply(cv::Mat& dst)
+{
+	if(src.data != dst.data)
+		src.copyTo(dst);
+
+	base_rect = boundingRect();
+	dst(base_rect).copyTo(base);
+
+	composite(dst);
+}
+
+void MakeupLook::update(cv::Mat& dst)
+{
+	assert(dst.size() == src.size() && dst.type() == src.type());
+
+	// Pixels outside base_rect have never been touched since apply(), so after putting the base back, dst is the
+	// same as source image and can be saved again if the bounding rectangle changed.
+	if(base_rect.area() > 0)
+		base.copyTo(dst(base_rect));
+
+	const Rect rect = boundingRect();
+	if(rect != base_rect)
+	{
+		base_rect = rect;
+		dst(base_rect).copyTo(base);
+	}
+
+	composite(dst);
+}
+
+} /* namespace venus */
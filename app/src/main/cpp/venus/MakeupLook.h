@@ -0,0 +1,134 @@
+#ifndef VENUS_MAKEUP_LOOK_H_
+#define VENUS_MAKEUP_LOOK_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "venus/Makeup.h"
+
+namespace venus {
+
+/**
+ * A whole look made of several cosmetics on one face. Calling Makeup::apply*() one after another copies and
+ * walks the whole image once per cosmetic, while MakeupLook gathers all the layers first, then composites them
+ * in a single tiled parallel pass, only within the bounding rectangle of the layers.
+ *
+ * <pre>
+ *	MakeupLook look(image, points);
+ *	look.addBrow(brow, color, 0.8F);
+ *	look.addBlush(Makeup::BlushShape::DEFAULT, color, 0.5F);
+ *	look.addLip(color, 0.6F);
+ *	look.apply(image);  // in place, pixels outside the face are never touched.
+ * </pre>
+ *
+ * The look is retained, all the geometry work (warped cosmetics, masks, rectangles) is done once when a cosmetic
+ * is added. Dragging a slider then only changes the parameter and blends again over the bounding rectangle:
+ *
+ * <pre>
+ *	look.setAmount(lip, 0.7F);
+ *	look.update(image);
+ * </pre>
+ */
+class MakeupLook
+{
+private:
+	struct Item
+	{
+		std::vector<Makeup::Layer> layers;
+		size_t fixed;  ///< count of leading layers not affected by amount or color, like the erased brows.
+		cv::Mat iris;  ///< mask of iris, whose amount is its size, so the layers are calculated again.
+	};
+
+	cv::Mat src;
+	std::vector<cv::Point2f> points;
+
+	std::vector<Item> cosmetics;  ///< in the order they are added
+
+	cv::Mat  base;       ///< untouched pixels of the destination image within base_rect, saved by apply()
+	cv::Rect base_rect;
+
+	int add(std::vector<Makeup::Layer>&& layers, size_t fixed = 0);
+	void composite(cv::Mat& dst) const;
+
+public:
+	/**
+	 * @param[in] src     The source image, it's referenced but not copied, so keep it unchanged until all the
+	 *                    cosmetics are added. When working in place, add cosmetics before the first apply().
+	 * @param[in] points  Feature points detected from <code>src</code> image.
+	 */
+	MakeupLook(const cv::Mat& src, const std::vector<cv::Point2f>& points);
+
+	/**@{
+	 * Add a cosmetic on top of the previous ones, parameters are the same as Makeup::apply*() counterparts.
+	 *
+	 * @return index of the cosmetic in this look.
+	 */
+	int addBrow(const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F,
+			InpaintMethod method = InpaintMethod::INTERPOLATION);
+	int addEye(const cv::Mat& cosmetic, float amount);
+	int addEyeLash(const cv::Mat& mask, uint32_t color, float amount);
+	int addEyeShadow(cv::Mat mask[3], uint32_t color[3], float amount);
+	int addIris(const cv::Mat& mask, float amount);
+	int addBlush(Makeup::BlushShape shape, uint32_t color, float amount);
+	int addBlush(const cv::Mat& mask, uint32_t color, float amount);
+	int addLip(uint32_t color, float amount);
+	/**@}*/
+
+	/**
+	 * Switch the brow style of a cosmetic added by addBrow(), the original brows stay erased, and only the new
+	 * brow layers are calculated. Call update() to see the result.
+	 *
+	 * @param[in] index  Index returned by addBrow().
+	 */
+	void setBrow(int index, const cv::Mat& brow, uint32_t color, float amount, float offsetY = 0.0F);
+
+	/**
+	 * Change blending amount of a cosmetic, call update() to see the result.
+	 *
+	 * @param[in] index   Index returned by add*() functions.
+	 * @param[in] amount  Blending amount in range [0, 1].
+	 */
+	void setAmount(int index, float amount);
+
+	/**
+	 * Change color of a cosmetic which is a mask filled with color, namely brow of gray image, eye lash, blush and
+	 * lip. It has no effect on colored cosmetics, call update() to see the result.
+	 *
+	 * @param[in] index  Index returned by add*() functions.
+	 * @param[in] color  0xAABBGGRR or RGBA memory layout.
+	 */
+	void setColor(int index, uint32_t color);
+
+	/**
+	 * Take off a cosmetic. Indices of other cosmetics stay the same, call update() to see the result.
+	 */
+	void remove(int index);
+
+	void clear();
+
+	/**
+	 * @return Bounding rectangle of all the layers on the source image, which is the only area apply() works on.
+	 */
+	cv::Rect boundingRect() const;
+
+	/**
+	 * Composite all the cosmetics, and save the untouched pixels under them for update().
+	 *
+	 * @param[out] dst  The result. Pass the source image itself to work in place, otherwise the source image is
+	 *                  copied to @p dst first.
+	 */
+	void apply(cv::Mat& dst);
+
+	/**
+	 * Composite all the cosmetics again after parameters changed. Only pixels within the bounding rectangle are
+	 * restored and blended, which is much cheaper than apply() for a large image.
+	 *
+	 * @param[in,out] dst  The same image passed to apply() last time, and not modified since then.
+	 */
+	void update(cv::Mat& dst);
+};
+
+} /* namespace venus */
+#endif /* VENUS_MAKEUP_LOOK_H_ */
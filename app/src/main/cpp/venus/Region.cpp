@@ -1,6 +1,7 @@
 #include "venus/Effect.h"
 #include "venus/opencv_utility.h"
 #include "venus/Region.h"
+#include "venus/scalar.h"
 
 #include <stdint.h>
 
@@ -339,6 +340,74 @@ void Region::grow(cv::Mat& dst, const cv::Mat& src, int offset)
 	shrink(dst, src, -offset);
 }
 
+void Region::distanceField(cv::Mat& dst, const cv::Mat& mask, int margin/* = 0 */)
+{
+	assert(!mask.empty() && mask.type() == CV_8UC1 && margin >= 0);
+
+	Mat inside;
+	cv::copyMakeBorder(mask, inside, margin, margin, margin, margin, BORDER_CONSTANT, Scalar(0));
+	Mat outside = (inside == 0);
+
+	// distanceTransform() measures distance to the nearest zero pixel for each non-zero pixel.
+	Mat distance_inside, distance_outside;
+	cv::distanceTransform(inside,  distance_inside,  DIST_L2, DIST_MASK_PRECISE, CV_32F);
+	cv::distanceTransform(outside, distance_outside, DIST_L2, DIST_MASK_PRECISE, CV_32F);
+
+	dst.create(inside.rows, inside.cols, CV_32FC1);
+
+	// Pixel centers are 1 pixel away from their neighbors across the edge, place the edge in between.
+	#pragma omp parallel for
+	for(int r = 0; r < dst.rows; ++r)
+	{
+		const float* in  = distance_inside.ptr<float>(r);
+		const float* out = distance_outside.ptr<float>(r);
+		float* d = dst.ptr<float>(r);
+		for(int c = 0; c < dst.cols; ++c)
+			d[c] = (in[c] > 0.0F) ? 0.5F - in[c] : out[c] - 0.5F;
+	}
+}
+
+void Region::feather(cv::Mat& dst, const cv::Mat& distance, float offset, float radius)
+{
+	assert(distance.type() == CV_32FC1 && radius >= 0.0F);
+	dst.create(distance.rows, distance.cols, CV_8UC1);
+
+	const float from = offset - radius;
+	const float inv_width = radius > 0.0F ? 1.0F / (2 * radius) : 0.0F;
+
+	#pragma omp parallel for
+	for(int r = 0; r < dst.rows; ++r)
+	{
+		const float* d = distance.ptr<float>(r);
+		uint8_t* m = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < dst.cols; ++c)
+		{
+			if(radius <= 0.0F)
+			{
+				m[c] = (d[c] <= offset) ? 255 : 0;
+				continue;
+			}
+
+			float t = clamp((d[c] - from) * inv_width, 0.0F, 1.0F);
+			m[c] = static_cast<uint8_t>(cvRound(255 * (1.0F - t * t * (3 - 2 * t))));
+		}
+	}
+}
+
+void Region::updateDistanceField(int margin)
+{
+	distanceField(distance, mask, margin);
+}
+
+cv::Mat Region::feather(float offset, float radius) const
+{
+	assert(!distance.empty());  // call updateDistanceField() first
+
+	Mat result;
+	feather(result, distance, offset, radius);
+	return result;
+}
+
 void Region::overlay(cv::Mat& dst, const cv::Mat& patch, const cv::Point2i& position, const cv::Mat& mask)
 {
 	assert(patch.size() == mask.size());
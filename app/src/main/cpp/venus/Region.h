@@ -31,6 +31,7 @@ public:
 	cv::Point2f pivot;  ///< pin point, relative to source image.
 	cv::Size2f  size;   ///< ROI's raw size, namely neither scaled nor rotated image size.
 	cv::Mat     mask;   ///< mask of ROI(Region Of Interest).
+	cv::Mat     distance;  ///< optional signed distance field of mask, @see updateDistanceField().
 
 public:
 	Region() = default;
@@ -114,6 +115,42 @@ public:
 	 * @param[in]  offset 
 	 */
 	static void grow(cv::Mat& dst, const cv::Mat& src, int offset);
+
+	/**
+	 * Signed Euclidean distance from every pixel to the edge of @p mask, negative inside and positive outside.
+	 * Both sides are calculated with cv::distanceTransform(DIST_MASK_PRECISE), which is a linear time algorithm
+	 * (Felzenszwalb & Huttenlocher), so the cost only depends on mask size, not on how far it will be feathered.
+	 *
+	 * @param[out] dst    Distance field of type CV_32FC1, of size (mask.cols + 2*margin, mask.rows + 2*margin).
+	 * @param[in]  mask   CV_8UC1 mask, nonzero pixels are inside.
+	 * @param[in]  margin Extend the field outwards by margin pixels on each side, so there is room to grow or feather.
+	 */
+	static void distanceField(cv::Mat& dst, const cv::Mat& mask, int margin = 0);
+
+	/**
+	 * Turn a distance field into a soft mask with a per-pixel smoothstep, no blur pass involved. It's cheap
+	 * enough to be called on every slider change, keep the distance field around instead of the blurred mask.
+	 *
+	 * @param[out] dst      CV_8UC1 mask of the same size as @p distance.
+	 * @param[in]  distance Signed distance field, @see distanceField().
+	 * @param[in]  offset   Move the edge outwards (positive) or inwards (negative), like grow() and shrink().
+	 * @param[in]  radius   Feather radius, mask goes from 255 down to 0 in range [offset - radius, offset + radius].
+	 *                      0 means a hard edge.
+	 */
+	static void feather(cv::Mat& dst, const cv::Mat& distance, float offset, float radius);
+
+	/**
+	 * Calculate distance field of this region's mask and keep it in member @p distance.
+	 *
+	 * @param[in] margin  @see distanceField(cv::Mat&, const cv::Mat&, int)
+	 */
+	void updateDistanceField(int margin);
+
+	/**
+	 * Soft mask from the cached distance field, updateDistanceField() must be called first. Note that the
+	 * result is larger than @p mask by margin pixels on each side.
+	 */
+	cv::Mat feather(float offset, float radius) const;
 	
 	static void overlay(cv::Mat& dst, const cv::Mat& patch, const cv::Point2i& position, const cv::Mat& mask);
 	void overlay(cv::Mat& mat, const cv::Mat& patch) const;
@@ -2,6 +2,8 @@
 #include "venus/colorspace.h"
 #include "venus/scalar.h"
 
+#include <opencv2/core/hal/intrin.hpp>
+
 namespace venus {
 
 uint32_t mix(const uint32_t& from, const uint32_t& to, float amount)
@@ -59,6 +61,32 @@ cv::Vec4f mix(const cv::Vec4f& from, const cv::Vec4f& to, float amount)
 	return result;
 }
 
+void mix(uint8_t* dst, const uint8_t* from, const uint8_t* to, const uint8_t* weight, int length)
+{
+	int i = 0;
+#if CV_SIMD128
+	const cv::v_uint16x8 _1 = cv::v_setall_u16(1), _127 = cv::v_setall_u16(127), _255 = cv::v_setall_u16(255);
+	for(; i <= length - 16; i += 16)
+	{
+		cv::v_uint16x8 from0, from1, to0, to1, weight0, weight1;
+		cv::v_expand(cv::v_load(from   + i), from0,   from1);
+		cv::v_expand(cv::v_load(to     + i), to0,     to1);
+		cv::v_expand(cv::v_load(weight + i), weight0, weight1);
+
+		// 255 * 255 + 127 fits in uint16_t, so does everything below.
+		cv::v_uint16x8 sum0 = cv::v_mul_wrap(from0, _255 - weight0) + cv::v_mul_wrap(to0, weight0) + _127;
+		cv::v_uint16x8 sum1 = cv::v_mul_wrap(from1, _255 - weight1) + cv::v_mul_wrap(to1, weight1) + _127;
+
+		// x / 255 == (x + 1 + (x >> 8)) >> 8 holds for x in [0, 65534]
+		sum0 = (sum0 + _1 + (sum0 >> 8)) >> 8;
+		sum1 = (sum1 + _1 + (sum1 >> 8)) >> 8;
+		cv::v_store(dst + i, cv::v_pack(sum0, sum1));
+	}
+#endif
+	for(; i < length; ++i)
+		dst[i] = (from[i] * (255 - weight[i]) + to[i] * weight[i] + 127) / 255;
+}
+
 #define blendHSL(i)          \
 	float hslA[3], hslB[3];	 \
 	rgb2hsl(rgbA, hslA);     \
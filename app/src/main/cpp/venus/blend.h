@@ -57,6 +57,19 @@ cv::Vec4f mix(const cv::Vec4f& from, const cv::Vec4f& to, float amount);
  */
 uint32_t mix(const uint32_t& from, const uint32_t& to, float amount);
 
+/**
+ * Mix two spans of bytes, dst[i] = (from[i] * (255 - weight[i]) + to[i] * weight[i] + 127) / 255, namely
+ * lerp(from[i], to[i], weight[i]) of uint8_t amount, which is also what the uint8_t mix() above calculates.
+ * It's vectorized with OpenCV's universal intrinsics, so it's the building block for 8-bit blending loops.
+ *
+ * @param[out] dst     Result, can be the same as @p from or @p to.
+ * @param[in]  from    Value at weight 0.
+ * @param[in]  to      Value at weight 255.
+ * @param[in]  weight  Weight of @p to, in range [0, 255].
+ * @param[in]  length  Number of bytes.
+ */
+void mix(uint8_t* dst, const uint8_t* from, const uint8_t* to, const uint8_t* weight, int length);
+
 
 
 // gimp/app/actions/layers-commands.c
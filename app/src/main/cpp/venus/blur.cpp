@@ -1,4 +1,7 @@
 #include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 #include <opencv2/imgproc.hpp>
 
@@ -10,6 +13,128 @@ using namespace cv;
 
 namespace venus {
 
+/**
+ * Coefficients of recursive Gaussian filter, see "Recursive implementation of the Gaussian filter",
+ * Ian T. Young and Lucas J. van Vliet, 1995. Normalized so that w[n] = B*x[n] + b1*w[n-1] + b2*w[n-2] + b3*w[n-3].
+ */
+struct RecursiveGaussian
+{
+	float B, b1, b2, b3;
+	int padding;  ///< zeros appended to a line, so that the backward pass starts on a settled state
+
+	explicit RecursiveGaussian(float sigma)
+	{
+		assert(sigma >= 0.5F);
+		const double q = sigma >= 2.5F ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+		const double q2 = q * q, q3 = q2 * q;
+		const double a0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+		const double a1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+		const double a2 = -(1.4281 * q2 + 1.26661 * q3);
+		const double a3 = 0.422205 * q3;
+
+		b1 = static_cast<float>(a1 / a0);
+		b2 = static_cast<float>(a2 / a0);
+		b3 = static_cast<float>(a3 / a0);
+		B  = static_cast<float>(1 - (a1 + a2 + a3) / a0);
+		padding = static_cast<int>(std::ceil(4 * sigma));
+	}
+};
+
+/**
+ * Filter a line of @p length elements with @p stride in place, pixels out of the line are taken as zero.
+ *
+ * @param[in,out] data    The line.
+ * @param[in]     buffer  Room for at least length + padding elements.
+ */
+static void filterLine(float* data, int length, int stride, const RecursiveGaussian& g, float* buffer)
+{
+	// causal pass, the state starts from zeros before the line
+	float w1 = 0, w2 = 0, w3 = 0;
+	for(int i = 0; i < length + g.padding; ++i)
+	{
+		const float x = i < length ? data[i * stride] : 0.0F;
+		const float w = g.B * x + g.b1 * w1 + g.b2 * w2 + g.b3 * w3;
+		buffer[i] = w;
+		w3 = w2; w2 = w1; w1 = w;
+	}
+
+	// anti-causal pass, from the end of zeros appended
+	float y1 = 0, y2 = 0, y3 = 0;
+	for(int i = length + g.padding - 1; i >= 0; --i)
+	{
+		const float y = g.B * buffer[i] + g.b1 * y1 + g.b2 * y2 + g.b3 * y3;
+		if(i < length)
+			data[i * stride] = y;
+		y3 = y2; y2 = y1; y1 = y;
+	}
+}
+
+void recursiveGaussianBlur(cv::Mat& dst, const cv::Mat& src, float sigma)
+{
+	assert(src.depth() == CV_8U || src.depth() == CV_32F);
+	assert(sigma >= 0.5F);
+
+	const RecursiveGaussian g(sigma);
+	Mat image;
+	src.convertTo(image, CV_32F);
+
+	const int cn = image.channels();
+	const int width = image.cols * cn;
+
+	// horizontal pass, each channel is a line with stride
+	#pragma omp parallel for
+	for(int r = 0; r < image.rows; ++r)
+	{
+		std::vector<float> buffer(image.cols + g.padding);
+		float* row = image.ptr<float>(r);
+		for(int k = 0; k < cn; ++k)
+			filterLine(row + k, image.cols, cn, g, buffer.data());
+	}
+
+	// vertical pass, on blocks of columns so that rows are read contiguously and the inner loop vectorizes.
+	constexpr int BLOCK = 64;
+	const int block_count = (width + BLOCK - 1) / BLOCK;
+	const int length = image.rows + g.padding;
+
+	#pragma omp parallel for
+	for(int block = 0; block < block_count; ++block)
+	{
+		const int c0 = block * BLOCK, n = std::min(BLOCK, width - c0);
+		std::vector<float> buffer(length * n);
+		float s1[BLOCK] = {}, s2[BLOCK] = {}, s3[BLOCK] = {};
+
+		for(int r = 0; r < length; ++r)
+		{
+			const float* row = r < image.rows ? image.ptr<float>(r) + c0 : nullptr;
+			float* w = buffer.data() + r * n;
+			for(int i = 0; i < n; ++i)
+			{
+				const float x = row != nullptr ? row[i] : 0.0F;
+				w[i] = g.B * x + g.b1 * s1[i] + g.b2 * s2[i] + g.b3 * s3[i];
+				s3[i] = s2[i]; s2[i] = s1[i]; s1[i] = w[i];
+			}
+		}
+
+		std::fill_n(s1, BLOCK, 0.0F);
+		std::fill_n(s2, BLOCK, 0.0F);
+		std::fill_n(s3, BLOCK, 0.0F);
+		for(int r = length - 1; r >= 0; --r)
+		{
+			const float* w = buffer.data() + r * n;
+			float* row = r < image.rows ? image.ptr<float>(r) + c0 : nullptr;
+			for(int i = 0; i < n; ++i)
+			{
+				const float y = g.B * w[i] + g.b1 * s1[i] + g.b2 * s2[i] + g.b3 * s3[i];
+				s3[i] = s2[i]; s2[i] = s1[i]; s1[i] = y;
+				if(row != nullptr)
+					row[i] = y;
+			}
+		}
+	}
+
+	image.convertTo(dst, src.depth());
+}
+
 void gaussianBlur(cv::Mat& dst, const cv::Mat& src, float radius)
 {
 	assert(radius >= 0);
@@ -18,219 +143,369 @@ void gaussianBlur(cv::Mat& dst, const cv::Mat& src, float radius)
 	int width = (r << 1) + 1;
 	double std_dev = radius * 3;  // 3-sigma rule https://en.wikipedia.org/wiki/68C95C99.7_rule
 
+	// Cost of the kernel grows with radius, switch to recursive filter of the same variance for large ones.
+	constexpr int RECURSIVE_RADIUS = 8;
+	if(r >= RECURSIVE_RADIUS && (src.depth() == CV_8U || src.depth() == CV_32F))
+	{
+		double sum = 0, variance = 0;
+		for(int x = -r; x <= r; ++x)
+		{
+			const double w = std::exp(-0.5 * x * x / (std_dev * std_dev));
+			sum += w;
+			variance += w * x * x;
+		}
+
+		recursiveGaussianBlur(dst, src, static_cast<float>(std::sqrt(variance / sum)));
+		return;
+	}
+
 	cv::GaussianBlur(src, dst, Size(width, width), std_dev, std_dev, cv::BorderTypes::BORDER_CONSTANT);
 }
 
-void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance)
+/**
+ * Selective blur of one channel by bilateral grid, see "A Fast Approximation of the Bilateral Filter using a Signal
+ * Processing Approach", Sylvain Paris and Fredo Durand, 2006. Pixels are splatted into cells of @p spacing in space and
+ * @p tolerance in value, the grid is blurred in space, then sliced at each pixel's own value. Grid rows are streamed
+ * from top to bottom, so that only a few of them are alive at a time.
+ *
+ * @param[in] y_begin, y_end  Range of grid rows to slice, pixel row r lies in grid row floor(r / spacing).
+ */
+template <typename T>
+static void blurSelectiveBand(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, int channel,
+		float spacing, float minimum, float tolerance, int levels, int y_begin, int y_end)
 {
-	assert(dst.data != src.data);
-	int R = cvRound(radius);
-	if(R <= 1)
+	const int N = src.channels();
+	const float inv_spacing = 1.0F / spacing, inv_tolerance = 1.0F / tolerance;
+	const int width = cvFloor((src.cols - 1) * inv_spacing) + 2;
+	const int height = cvFloor((src.rows - 1) * inv_spacing) + 2;
+	const int length = width * levels * 2;  // (weighted value, weight) pairs of a grid row
+	const float KERNEL[5] = { 1/16.0F, 4/16.0F, 6/16.0F, 4/16.0F, 1/16.0F };
+
+	// pixel column c is splatted to the nearest cell, and sliced between cell x0 and x0 + 1.
+	std::vector<int> splat_x(src.cols), slice_x(src.cols);
+	std::vector<float> slice_fx(src.cols);
+	for(int c = 0; c < src.cols; ++c)
 	{
-		src.copyTo(dst);
-		return;
+		const float x = c * inv_spacing;
+		splat_x[c] = cvFloor(x + 0.5F) * levels * 2;
+		slice_x[c] = cvFloor(x);
+		slice_fx[c] = x - slice_x[c];
+		slice_x[c] *= levels * 2;
 	}
-	
-	int width = (R << 1) + 1;
-#if 0
-	std::vector<cv::Mat> channels;
-	cv::split(src, channels);
 
-	const int N = src.channels() < 4 ? src.channels() : 3;
-	#pragma omp parallel for
-//	for(cv::Mat& channel: src_channels)  // It seems that OpenMP doesn't support range based for in C++11.
-	// error C3016: 'i' : index variable in OpenMP 'for' statement must have signed integral type
-	// The Microsoft C/C++ Compiler 12.0 integrated with Visual Studio 2013 still only support OpenMP 2.5 and doesn't allow unsigned int for the loop counter.
-	// GCC support OpenMP 3.0 since its version 4.4 and allows unsigned int for the loop counter.
-	for(int i = 0; i < N; ++i)
-	{
-		cv::Mat& channel = channels[i];
-		cv::Mat tmp;  // Bilateral filter does not work inplace.
-		cv::bilateralFilter(channel, tmp, width, width*2.0, width/2.0);
-		channel = tmp;
-	}
+	std::vector<float> buffer(length * 8, 0.0F);
+	float* const grid = buffer.data();
+	float* ring[5];  // x-blurred rows j-2 .. j+2 for blurred row j
+	for(int i = 0; i < 5; ++i)
+		ring[i] = grid + length * (i + 1);
+	float* lower = grid + length * 6;
+	float* upper = grid + length * 7;
 
-	cv::merge(channels.data(), channels.size(), dst);
-#else
-	Mat _src;
-	src.convertTo(_src, CV_32F);
-//	dst.create(src.rows, src.cols, CV_32F);
-	_src.copyTo(dst);
-	
-	assert(mask.type() == CV_8UC1);
-	const uint8_t* const mask_data = mask.ptr<uint8_t>();
-//	Mat _mask = normalize(mask);
-//	const float* const mask_data = mask.ptr<float>();
-
-	// initialize Gaussian kernel
-	float sum = 0.0F;
-	Mat kernel(width, width, CV_32FC1);
-//	kernel.at<float>(R, R) = 1.0F;
-	for(int r = 0; r <= R; ++r)
-	for(int c = 0; c <= R; ++c)
+	auto splatRow = [&](int i, float* row)
 	{
-		float v = std::exp(-0.5F * (r*r + c*c) / radius);
-		kernel.at<float>(R - r, R - c) = v;
-		kernel.at<float>(R - r, R + c) = v;
-		kernel.at<float>(R + r, R - c) = v;
-		kernel.at<float>(R + r, R + c) = v;
-		sum += v * 4;
-	}
-	printf("kernel sum: %f\n", sum);
-	//TODO scale all the values???
+		std::fill(row, row + length, 0.0F);
+		if(i < 0 || i >= height)
+			return;
+
+		std::fill(grid, grid + length, 0.0F);
+		const int r_begin = std::max(cvFloor((i - 1) * spacing), 0);
+		const int r_end = std::min(cvCeil((i + 1) * spacing) + 1, src.rows);
+		for(int r = r_begin; r < r_end; ++r)
+		{
+			if(cvFloor(r * inv_spacing + 0.5F) != i)
+				continue;
 
-	const int channel = src.channels();
-	assert(channel >= 3);  // currently only support color image
-	const int length = src.rows * src.cols;
+			const T* p = src.ptr<T>(r) + channel;
+			for(int c = 0; c < src.cols; ++c, p += N)
+			{
+				const float value = static_cast<float>(*p);
+				const float z = (value - minimum) * inv_tolerance;
+				const int k = std::min(static_cast<int>(z), levels - 2);
+				const float f = z - k;
+				float* cell = grid + splat_x[c] + k * 2;
+				cell[0] += (1 - f) * value;
+				cell[1] += 1 - f;
+				cell[2] += f * value;
+				cell[3] += f;
+			}
+		}
 
-	assert(_src.depth() == CV_32F && dst.depth() == CV_32F);
-	const float* const _src_data = _src.ptr<float>();
-	float* const dst_data = dst.ptr<float>();
+		for(int x = 0; x < width; ++x)
+		{
+			float* out = row + x * levels * 2;
+			for(int k = std::max(-2, -x); k <= std::min(2, width - 1 - x); ++k)
+			{
+				const float w = KERNEL[k + 2];
+				const float* in = grid + (x + k) * levels * 2;
+				for(int z = 0; z < levels * 2; ++z)
+					out[z] += w * in[z];
+			}
+		}
+	};
 
-	#pragma omp parallel for
-	for(int k = 0; k < length; ++k)
+	auto sliceRows = [&](int j)
 	{
-		if(mask_data[k] == 0)
-			continue;
-
-		int r = k / src.cols, c = k % src.cols;
-		int offset = k * channel;
-		const float* center = _src_data + offset;
-		
-		Vec3f accumulated(0, 0, 0), count(0, 0, 0);
-		for(int y = -R; y <= R; ++y)
+		const int r_begin = std::max(cvFloor(j * spacing) - 1, 0);
+		const int r_end = std::min(cvCeil((j + 1) * spacing) + 1, src.rows);
+		for(int r = r_begin; r < r_end; ++r)
 		{
-			int j = r + y;
-			if(j < 0 || j >= src.rows)
+			if(cvFloor(r * inv_spacing) != j)
 				continue;
 
-			for(int x = -R; x <= R; ++x)
+			const float fy = r * inv_spacing - j;
+			const uint8_t* m = mask.ptr<uint8_t>(r);
+			const T* p = src.ptr<T>(r) + channel;
+			T* q = dst.ptr<T>(r) + channel;
+			for(int c = 0; c < src.cols; ++c, p += N, q += N)
 			{
-				int i = c + x;
-				if(i < 0 || i >= src.cols)
+				if(m[c] == 0)
 					continue;
-				
-				float weight = kernel.at<float>(R + y, R + x);
-				const float* around = _src_data + (j * src.cols + i) * channel;
-#if 1
-				// individual channel
-				for(int m = 0; m < 3; ++m)
+
+				const float value = static_cast<float>(*p);
+				const float z = (value - minimum) * inv_tolerance;
+				const int k = std::min(static_cast<int>(z), levels - 2);
+				const float fz = z - k, fx = slice_fx[c];
+				const float weights[4] = { (1 - fy) * (1 - fx), (1 - fy) * fx, fy * (1 - fx), fy * fx };
+				const float* cells[4] =
 				{
-					float diff = std::abs(center[m] - around[m]);
-					if(diff > tolerance)
-						continue;
-					
-					accumulated[m] += weight * around[m];
-					count[m] += weight;
-				}
-#else
-				// RGB weighted measure method
-				float diff = (std::abs(center[0] - around[0]) +
-					std::abs(center[1] - around[1]) + std::abs(center[2] - around[2]))/3;
-				if(diff > tolerance)
-					continue;
+					lower + slice_x[c] + k * 2, lower + slice_x[c] + levels * 2 + k * 2,
+					upper + slice_x[c] + k * 2, upper + slice_x[c] + levels * 2 + k * 2,
+				};
 
-				for(int m = 0; m < 3; ++m)
+				float sum = 0.0F, weight = 0.0F;
+				for(int i = 0; i < 4; ++i)
 				{
-					accumulated[m] += weight * around[m];
-					count[m] += weight;
+					const float* cell = cells[i];
+					sum    += weights[i] * ((1 - fz) * cell[0] + fz * cell[2]);
+					weight += weights[i] * ((1 - fz) * cell[1] + fz * cell[3]);
 				}
-#endif
+
+				if(weight > 0)
+					*q = saturate_cast<T>(sum / weight);
+			}
+		}
+	};
+
+	for(int i = y_begin - 2; i < y_begin + 2; ++i)
+		splatRow(i, ring[i - y_begin + 3]);
+
+	for(int j = y_begin; j <= y_end; ++j)
+	{
+		std::rotate(ring, ring + 1, ring + 5);
+		splatRow(j + 2, ring[4]);
+
+		std::fill(upper, upper + length, 0.0F);
+		for(int k = 0; k < 5; ++k)
+			for(int z = 0; z < length; ++z)
+				upper[z] += KERNEL[k] * ring[k][z];
+
+		if(j > y_begin)
+			sliceRows(j - 1);
+		std::swap(lower, upper);
+	}
+}
+
+template <typename T>
+static void blurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance)
+{
+	const int N = std::min(src.channels(), 3);  // alpha channel is kept
+	const int rows = src.rows, cols = src.cols;
+
+	float minimum[3], range[3];
+	for(int i = 0; i < N; ++i)
+	{
+		float min = static_cast<float>(src.ptr<T>(0)[i]), max = min;
+		for(int r = 0; r < rows; ++r)
+		{
+			const T* p = src.ptr<T>(r) + i;
+			for(int c = 0; c < cols; ++c, p += src.channels())
+			{
+				min = std::min(min, static_cast<float>(*p));
+				max = std::max(max, static_cast<float>(*p));
 			}
 		}
+		minimum[i] = min;
+		range[i] = max - min;
+	}
+
+	/*
+	 * Kernel weight is exp(-d^2/(2*radius)). Nearest splatting, [1 4 6 4 1]/16 blurring and linear slicing of cells add
+	 * up to variance 1.25*spacing^2 in space. Linear splatting and slicing in value add up to variance tolerance^2/3,
+	 * the same as the box of half width tolerance it replaces.
+	 */
+	const float spacing = std::max(std::sqrt(radius / 1.25F), 1.0F);
+	const int height = cvFloor((rows - 1) * (1.0F / spacing)) + 2;
+	constexpr int MAX_LEVELS = 64, BAND = 32;
+	const int band_count = (height - 1 + BAND - 1) / BAND;
+
+	#pragma omp parallel for
+	for(int task = 0; task < N * band_count; ++task)
+	{
+		const int i = task / band_count, y_begin = task % band_count * BAND;
+		if(range[i] <= 0)  // a flat channel stays as it is
+			continue;
 
-		// weight_sum can not be ZERO, since center point is counted.
-		dst_data[offset + 0] = accumulated[0] / count[0];
-		dst_data[offset + 1] = accumulated[1] / count[1];
-		dst_data[offset + 2] = accumulated[2] / count[2];
+		const float step = std::max(tolerance, range[i] / MAX_LEVELS);
+		const int levels = cvFloor(range[i] / step) + 2;
+		blurSelectiveBand<T>(dst, src, mask, i, spacing, minimum[i], step, levels,
+				y_begin, std::min(y_begin + BAND, height - 1));
 	}
+}
 
+void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance)
+{
+	assert(dst.data != src.data);
+	assert(src.depth() == CV_8U || src.depth() == CV_32F);
+	assert(mask.type() == CV_8UC1 && mask.size() == src.size());
+	src.copyTo(dst);
+
+	const int R = cvRound(radius);
+	const Rect bounds = cv::boundingRect(mask);
+	if(R <= 1 || bounds.area() <= 0)
+		return;
+
+	// Pixels farther than R from the mask don't contribute.
+	const Rect rect = Rect(bounds.x - R, bounds.y - R, bounds.width + 2*R, bounds.height + 2*R)
+			& Rect(0, 0, src.cols, src.rows);
+	Mat dst_roi = dst(rect);
 	if(src.depth() == CV_8U)
-		dst.convertTo(dst, CV_8U);
-#endif
+		blurSelective<uint8_t>(dst_roi, src(rect), mask(rect), radius, tolerance);
+	else
+		blurSelective<float>(dst_roi, src(rect), mask(rect), radius, tolerance);
 }
 
 
-// Radius can be tuned, but dont't make the radius too large, since it's time-consuming.
-static constexpr float BLUR_RADIUS = 8;
+/**
+ * Average of box [r - h, r + h] x [c - h, c + h] clipped by image, from summed-area table @p table.
+ */
+static inline void boxAverage(float* average, const uint32_t* table, int stride, int N, int rows, int cols,
+		int r, int c, int h)
+{
+	const int top = std::max(r - h, 0), bottom = std::min(r + h + 1, rows);
+	const int left = std::max(c - h, 0), right = std::min(c + h + 1, cols);
+	const float inv_area = 1.0F / ((bottom - top) * (right - left));
+	const uint32_t* t = table + top * stride;
+	const uint32_t* b = table + bottom * stride;
+	for(int k = 0; k < N; ++k)
+	{
+		const uint32_t sum = b[right * N + k] - b[left * N + k] - t[right * N + k] + t[left * N + k];
+		average[k] = sum * inv_area;
+	}
+}
 
-static cv::Vec4b getBlurredValue(const cv::Mat& image, const cv::Point2i& point, const float& blur_radius)
+void variableBlur(cv::Mat& dst, const cv::Mat& src, const cv::Mat& radius)
 {
-	assert(image.type() == CV_8UC4 && blur_radius >= 1.0F);
-	int count = 0;
-	Vec4d sum(0, 0, 0, 0);
+	assert(src.depth() == CV_8U && src.channels() <= 4);
+	assert(radius.type() == CV_32FC1 && radius.size() == src.size());
+	const int rows = src.rows, cols = src.cols, N = src.channels();
+	const int stride = (cols + 1) * N;
 
-	const int R = static_cast<int>(std::ceil(blur_radius));
-	const int RR= static_cast<int>(blur_radius * blur_radius);
+	// Sums wrap around modulo 2^32, but differences of them are still exact, since no box sums up to 2^32.
+	std::vector<uint32_t> table((rows + 1) * stride, 0);
+	#pragma omp parallel for
+	for(int r = 0; r < rows; ++r)
+	{
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint32_t* q = table.data() + (r + 1) * stride;
+		for(int i = 0; i < cols * N; ++i)
+			q[N + i] = q[i] + p[i];
+	}
 
-	for(int dy = -R; dy < R; ++dy)
-	for(int dx = -R; dx < R; ++dx)
+	constexpr int BLOCK = 256;
+	#pragma omp parallel for
+	for(int begin = 0; begin < stride; begin += BLOCK)
 	{
-		if(dx*dx + dy*dy > RR)
-			continue;
+		const int end = std::min(begin + BLOCK, stride);
+		for(int r = 2; r <= rows; ++r)
+		{
+			uint32_t* q = table.data() + r * stride;
+			for(int i = begin; i < end; ++i)
+				q[i] += q[i - stride];
+		}
+	}
 
-		int c = point.x + dx, r = point.y + dy;
-		if(c < 0 || c >= image.cols || r < 0 || r >= image.rows)
-			continue;
-				
-		const Vec4b& color = image.at<Vec4b>(r, c);
-		sum += static_cast<Vec4d>(color);
-		++count;
+	dst.create(src.size(), src.type());  // src is no longer read, so dst can be src
+
+	// A box of side sqrt(pi) * radius has the same area as the disk, fractional sides interpolate between two boxes.
+	const float HALF_SQRT_PI = 0.886226925F;
+	#pragma omp parallel for
+	for(int r = 0; r < rows; ++r)
+	{
+		const float* radius_row = radius.ptr<float>(r);
+		const uint8_t* p = src.ptr<uint8_t>(r);
+		uint8_t* q = dst.ptr<uint8_t>(r);
+		for(int c = 0; c < cols; ++c, p += N, q += N)
+		{
+			const float h = radius_row[c] * HALF_SQRT_PI - 0.5F;
+			if(!(h > 0))
+			{
+				for(int k = 0; k < N; ++k)
+					q[k] = p[k];
+				continue;
+			}
+
+			const int h0 = static_cast<int>(h);
+			const float t = h - h0;
+			float a[4], b[4];
+			boxAverage(a, table.data(), stride, N, rows, cols, r, c, h0);
+			boxAverage(b, table.data(), stride, N, rows, cols, r, c, h0 + 1);
+			for(int k = 0; k < N; ++k)
+				q[k] = saturate_cast<uint8_t>(a[k] + t * (b[k] - a[k]));
+		}
 	}
+}
 
-	Vec4d avg = sum / count;
-	return Vec4b(
-		saturate_cast<uint8_t>(avg[0]),
-		saturate_cast<uint8_t>(avg[1]), 
-		saturate_cast<uint8_t>(avg[2]),
-		saturate_cast<uint8_t>(avg[3]));
+// Blur radius of the most blurred region, the cost doesn't depend on it.
+static constexpr float BLUR_RADIUS = 8;
+
+static void blurByRadius(cv::Mat& dst, const cv::Mat& src, const cv::Mat& radius)
+{
+#if DEBUG_BLUR
+	// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
+	cv::Mat weight;
+	radius.convertTo(weight, CV_8U, 255 / BLUR_RADIUS);
+	switch(src.channels())
+	{
+	case 3:  cv::cvtColor(weight, dst, cv::COLOR_GRAY2BGR);  break;
+	case 4:  cv::cvtColor(weight, dst, cv::COLOR_GRAY2BGRA); break;
+	default: weight.copyTo(dst);                             break;
+	}
+#else
+	variableBlur(dst, src, radius);
+#endif
 }
 
 void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius)
 {
 	assert(0 < inner_radius && inner_radius < outer_radius);
-	assert(src.data != dst.data);
-	src.copyTo(dst);
+	cv::Mat radius(src.rows, src.cols, CV_32FC1);
 
 	#pragma omp parallel for
 	for(int r = 0; r < src.rows; ++r)
-	for(int c = 0; c < src.cols; ++c)
 	{
-		Point2f point = Point2i(c, r);
-		float distance = venus::distance(point, center);
-
-#if DEBUG_BLUR
-		// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
-		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = Vec4b(255, 255, 255, 255);
-		else if(distance >= inner_radius)
-		{
-			float t = (distance - inner_radius) / (outer_radius - inner_radius);
-			uint8_t x = t * 253 + 1;  // map to interval [1, 254]
-			dst.at<Vec4b>(r, c) = Vec4b(x, x, x, 255);
-		}
-		else  // since blur radius == 1 means no blurring.
-			dst.at<Vec4b>(r, c) = Vec4b(0, 0, 0, 255);
-#else
-		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, BLUR_RADIUS);
-		else if(distance >= inner_radius)
+		float* radius_row = radius.ptr<float>(r);
+		for(int c = 0; c < src.cols; ++c)
 		{
-			float t = (outer_radius - distance) / (outer_radius - inner_radius);
-			float blur_radius = t * (BLUR_RADIUS - 1.0F) + 1.0F;
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, blur_radius);
+			float distance = venus::distance(Point2f(c, r), center);
+			if(distance >= outer_radius)
+				radius_row[c] = BLUR_RADIUS;
+			else if(distance >= inner_radius)
+			{
+				// since blur radius == 1 means almost no blurring.
+				float t = (distance - inner_radius) / (outer_radius - inner_radius);
+				radius_row[c] = t * (BLUR_RADIUS - 1.0F) + 1.0F;
+			}
+			else
+				radius_row[c] = 0.0F;
 		}
-//		else  // distance < inner_radius
-//			dst.at<Vec4b>(r, c) = src.at<Vec4b>(r, c);
-#endif
 	}
+
+	blurByRadius(dst, src, radius);
 }
 
 void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width)
 {
 	assert(band_width > 0);
-	assert(src.data != dst.data);
-	src.copyTo(dst);
 
 	Point2f center = (point1 + point0) / 2.0F;
 	Vec2f v01 = point1 - point0;
@@ -244,27 +519,24 @@ void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Poi
 	float inner_radius = half_length - band_width/2;
 	float outer_radius = half_length + band_width/2;
 
+	cv::Mat radius(src.rows, src.cols, CV_32FC1);
 	#pragma omp parallel for
 	for(int r = 0; r < src.rows; ++r)
-	for(int c = 0; c < src.cols; ++c)
 	{
-		Point2f point = Point2i(c, r);
-		float distance = venus::distance(point, line);
-#if DEBUG_BLUR
-		// color values are the weight of blurring radius, so white means full blurring, black means no blurring.
-		distance = venus::clamp(distance, inner_radius, outer_radius);
-		float t = (distance - inner_radius) / (outer_radius - inner_radius);
-		uint8_t x = t * 255;
-		dst.at<Vec4b>(r, c) = Vec4b(x, x, x, 255);
-#else
-		if(distance >= outer_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, BLUR_RADIUS);
-		else if(distance >= inner_radius)
-			dst.at<Vec4b>(r, c) = getBlurredValue(src, point, distance / outer_radius * BLUR_RADIUS);
-		else  // distance < inner_radius
-			dst.at<Vec4b>(r, c) = src.at<Vec4b>(r, c);
-#endif
+		float* radius_row = radius.ptr<float>(r);
+		for(int c = 0; c < src.cols; ++c)
+		{
+			float distance = venus::distance(Point2f(c, r), line);
+			if(distance >= outer_radius)
+				radius_row[c] = BLUR_RADIUS;
+			else if(distance >= inner_radius)
+				radius_row[c] = distance / outer_radius * BLUR_RADIUS;
+			else
+				radius_row[c] = 0.0F;
+		}
 	}
+
+	blurByRadius(dst, src, radius);
 }
 
 } /* namespace venus */
\ No newline at end of file
@@ -6,6 +6,19 @@
 namespace venus {
 
 /**
+ * Gaussian blur with recursive filter, its cost per pixel doesn't depend on @p sigma. Pixels out of image are taken
+ * as zero like BORDER_CONSTANT.
+ *
+ * @param[out] dst    The output image, it can be @p src.
+ * @param[in]  src    CV_8U or CV_32F image of any channels.
+ * @param[in]  sigma  Standard deviation, no less than 0.5.
+ */
+void recursiveGaussianBlur(cv::Mat& dst, const cv::Mat& src, float sigma);
+
+/**
+	* Radius above a threshold is done by recursiveGaussianBlur() with the same variance as the kernel, so that it
+	* costs the same for any large radius.
+	*
 	* Note that @p dst can be same as @p src image, so you can write:
 	* <code>
 	* gaussianBlur(image, image, radius);
@@ -20,17 +33,29 @@ void gaussianBlur(cv::Mat& dst, const cv::Mat& src, float radius);
 
 /**
  * "Selective Gaussian blur" blurs neighboring pixels, but only in low-contrast areas. It can't take in-place.
- * Large filters (radius > 5) are very slow, so it is recommended to use radius = 3 for real-time applications.
- * And a mask can be used to shorten processing time.
+ * It's approximated with a bilateral grid, whose cost doesn't grow with radius. Only the bounding rectangle of
+ * @p mask is processed, pixels out of mask are copied.
  *
- * @param[out] dst        The output image.
- * @param[in]  src        The input image.
- * @param[in]  mask       CV_8UC1 format
+ * @param[out] dst        The output image, of the same type as @p src.
+ * @param[in]  src        CV_8U or CV_32F image of 1 to 4 channels, the 4th channel (alpha) is kept.
+ * @param[in]  mask       CV_8UC1 format, pixels of nonzero value are blurred.
  * @param[in]  radius     Gaussian kernel radius, or bluring radius.
  * @param[in]  tolerance  Range [0, 255], pixels within tolerance will be handled.
  */
 void gaussianBlurSelective(cv::Mat& dst, const cv::Mat& src, const cv::Mat& mask, float radius, float tolerance);
 
+/**
+ * Blur with a radius of each pixel, as the base of radial, tilt-shift or depth of field blur. Every pixel is the average
+ * of a box of the same area as the disk of its radius. Box sums are looked up from a summed-area table, so that it costs
+ * the same for any radius.
+ *
+ * @param[out] dst     The output image, it can be @p src.
+ * @param[in]  src     CV_8UC1, CV_8UC3 or CV_8UC4 image.
+ * @param[in]  radius  CV_32FC1 blur radius of each pixel, of the same size as @p src, a radius of about half a pixel
+ *                     or less leaves the pixel as it is.
+ */
+void variableBlur(cv::Mat& dst, const cv::Mat& src, const cv::Mat& radius);
+
 void radialBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& center, float inner_radius, float outer_radius);
 void bilinearBlur(cv::Mat& dst, const cv::Mat& src, cv::Point2f& point0, cv::Point2f& point1, float band_width);
 
@@ -1,7 +1,13 @@
+#include <algorithm>
+
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
 
+#include "venus/blend.h"
 #include "venus/compiler.h"
 #include "venus/inpaint.h"
+#include "venus/Region.h"
 #include "venus/scalar.h"
 
 namespace venus {
@@ -19,7 +25,8 @@ void TemplateMatchCandidates::initialize()
 	const size_t nChannels = imageChannels.size();
 
 	_integrals.resize(nChannels);
-	for(size_t i = 0; i < nChannels; ++i)
+	#pragma omp parallel for
+	for(int i = 0; i < static_cast<int>(nChannels); ++i)
 		cv::integral(imageChannels[i], _integrals[i]);
 	
 	_blocks.clear();
@@ -44,29 +51,95 @@ void TemplateMatchCandidates::findCandidates(const cv::Mat &templ, const cv::Mat
 	cv::Mat1i referenceClass;
 	cv::Scalar templMean;
 	weakClassifiersForTemplate(templ, templMask, blocks, referenceClass, templMean);
-	
-	// For each channel we loop over all possible template positions and compare with classifiers.
-	for(size_t i = 0; i < _integrals.size(); ++i) 
-	{
-		cv::Mat1i &integral = _integrals[i];
-		const int *referenceClassRow = referenceClass.ptr<int>(static_cast<int>(i));
 
-		// For all template positions ty, tx (top-left template position)
-		for(int ty = 0; ty < candidates.rows; ++ty) 
+	const size_t step = _integrals[0].step1();
+	const BlockOffsets templOffsets(std::vector<cv::Rect>(1, cv::Rect(cv::Point(0, 0), templ.size())), step);
+	const BlockOffsets blockOffsets(blocks, step);
+	const int nChannels = static_cast<int>(_integrals.size());
+
+	// For all template positions ty, tx (top-left template position), each channel is compared in turn.
+	#pragma omp parallel for
+	for(int ty = 0; ty < candidates.rows; ++ty)
+	{
+		uchar *outputRow = candidates.ptr<uchar>(ty);
+		for(int i = 0; i < nChannels; ++i)
 		{
-			uchar *outputRow = candidates.ptr<uchar>(ty);
-			for(int tx = 0; tx < candidates.cols; ++tx) 
+			const int *integralRow = _integrals[i].ptr<int>(ty);
+			const int *referenceClassRow = referenceClass.ptr<int>(i);
+			const float mean = (float)templMean[i];
+
+			int tx = 0;
+#if CV_SIMD128
+			// Same arithmetic as compareWeakClassifiers(), but for 4 adjacent positions. Division rather than
+			// multiplication by reciprocal, so that results are exactly the same.
+			const cv::v_float32x4 templArea = cv::v_setall_f32(templOffsets.area[0]);
+			const cv::v_float32x4 v_mean = cv::v_setall_f32(mean), v_maxMeanDiff = cv::v_setall_f32(maxMeanDifference);
+			const cv::v_int32x4 v_maxWeakErrors = cv::v_setall_s32(maxWeakErrors);
+			for(; tx <= candidates.cols - 4; tx += 4)
+			{
+				if((outputRow[tx] | outputRow[tx + 1] | outputRow[tx + 2] | outputRow[tx + 3]) == 0)
+					continue;
+
+				const int *p = integralRow + tx;
+				const cv::v_int32x4 sum = cv::v_load(p + templOffsets.bottomRight[0]) - cv::v_load(p + templOffsets.bottomLeft[0])
+						- cv::v_load(p + templOffsets.topRight[0]) + cv::v_load(p);
+				const cv::v_float32x4 posMean = cv::v_cvt_f32(sum) / templArea;
+				const cv::v_int32x4 close = cv::v_reinterpret_as_s32(cv::v_abs(posMean - v_mean) <= v_maxMeanDiff);
+
+				cv::v_int32x4 errors = cv::v_setzero_s32();
+				for(int r = 0; r < blockOffsets.size(); ++r)
+				{
+					const cv::v_int32x4 blockSum = cv::v_load(p + blockOffsets.bottomRight[r]) - cv::v_load(p + blockOffsets.bottomLeft[r])
+							- cv::v_load(p + blockOffsets.topRight[r]) + cv::v_load(p + blockOffsets.topLeft[r]);
+					const cv::v_float32x4 blockMean = cv::v_cvt_f32(blockSum) / cv::v_setall_f32(blockOffsets.area[r]);
+
+					// all bits set where the class is 1, then mismatches are all bits set, which is -1.
+					const cv::v_int32x4 c = cv::v_reinterpret_as_s32(blockMean > posMean);
+					const cv::v_int32x4 reference = cv::v_setall_s32(referenceClassRow[r] == 1 ? -1 : 0);
+					errors = errors - (c ^ reference);
+				}
+
+				int pass[4];
+				cv::v_store(pass, close & (errors <= v_maxWeakErrors));
+				for(int k = 0; k < 4; ++k)
+					if(!pass[k])
+						outputRow[tx + k] = 0;
+			}
+#endif
+			for(; tx < candidates.cols; ++tx)
 			{
 				if(!outputRow[tx])
 					continue;
-				
-				outputRow[tx] = compareWeakClassifiers(integral, tx, ty, templ.size(), blocks, referenceClassRow, 
-						(float)templMean[static_cast<int>(i)], maxMeanDifference, maxWeakErrors);
+
+				outputRow[tx] = compareWeakClassifiers(integralRow + tx, templOffsets, blockOffsets, referenceClassRow,
+						mean, maxMeanDifference, maxWeakErrors);
 			}
 		}
 	}
 }
 
+TemplateMatchCandidates::BlockOffsets::BlockOffsets(const std::vector<cv::Rect> &rects, size_t step)
+{
+	const int length = static_cast<int>(rects.size());
+	topLeft.resize(length);
+	topRight.resize(length);
+	bottomLeft.resize(length);
+	bottomRight.resize(length);
+	area.resize(length);
+
+	// integral image has an extra row and column, so corners are at (x, y) and (x + width, y + height).
+	for(int r = 0; r < length; ++r)
+	{
+		const cv::Rect &b = rects[r];
+		const int top = static_cast<int>(b.y * step), bottom = static_cast<int>((b.y + b.height) * step);
+		topLeft[r]     = top + b.x;
+		topRight[r]    = top + b.x + b.width;
+		bottomLeft[r]  = bottom + b.x;
+		bottomRight[r] = bottom + b.x + b.width;
+		area[r] = static_cast<float>(b.width * b.height);
+	}
+}
+
 void TemplateMatchCandidates::weakClassifiersForTemplate(const cv::Mat &templ, const cv::Mat &templMask, const std::vector<cv::Rect> &rects, 
 		cv::Mat1i &classifiers, cv::Scalar &mean)
 {
@@ -86,31 +159,22 @@ void TemplateMatchCandidates::weakClassifiersForTemplate(const cv::Mat &templ, c
 	}
 }
 
-unsigned char TemplateMatchCandidates::compareWeakClassifiers(const cv::Mat1i &i, int x, int y, const cv::Size &templSize, 
-		const std::vector<cv::Rect> &blocks, const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors)
+unsigned char TemplateMatchCandidates::compareWeakClassifiers(const int *integral, const BlockOffsets &templ, const BlockOffsets &blocks,
+		const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors)
 {
-	const int *topRow = i.ptr<int>(y);
-	const int *bottomRow = i.ptr<int>(y + templSize.height); // +1 required for integrals
-	
+	const int *p = integral;
+
 	// Mean of image under given template position
-	const float posMean = (bottomRow[x + templSize.width] - bottomRow[x] - topRow[x + templSize.width] + topRow[x]) / static_cast<float>(templSize.area());
+	const float posMean = (p[templ.bottomRight[0]] - p[templ.bottomLeft[0]] - p[templ.topRight[0]] + p[templ.topLeft[0]]) / templ.area[0];
 
 	if(std::abs(posMean - templateMean) > maxMeanDiff)
 		return 0;
 
 	// Evaluate means of sub-blocks
 	int sumErrors = 0;
-	for(size_t r = 0; r < blocks.size(); ++r)
+	for(int r = 0; r < blocks.size(); ++r)
 	{
-		const cv::Rect &b = blocks[r];
-
-		int ox = x + b.x;
-		int oy = y + b.y;
-
-		const int *topRow = i.ptr<int>(oy);
-		const int *bottomRow = i.ptr<int>(oy + b.height);
-
-		const float blockMean = (bottomRow[ox + b.width] - bottomRow[ox] - topRow[ox + b.width] + topRow[ox]) / static_cast<float>(b.width * b.height);
+		const float blockMean = (p[blocks.bottomRight[r]] - p[blocks.bottomLeft[r]] - p[blocks.topRight[r]] + p[blocks.topLeft[r]]) / blocks.area[r];
 		const int c = blockMean > posMean ? 1 : -1;
 		sumErrors += (c != compareTo[r]) ? 1 : 0;
 
@@ -299,6 +363,100 @@ inline bool isCenteredPatchCrossingBoundary(cv::Point p, int halfPatchSize, cons
 
 constexpr int PATCHFLAGS = PATCH_BOUNDS;
 
+void IndexedHeap::reset(int size)
+{
+	_heap.clear();
+	_slot.assign(size, -1);
+	_priority.assign(size, 0.0F);
+}
+
+bool IndexedHeap::before(int a, int b) const
+{
+	return _priority[a] > _priority[b] || (_priority[a] == _priority[b] && a < b);
+}
+
+void IndexedHeap::place(int slot, int index)
+{
+	_heap[slot] = index;
+	_slot[index] = slot;
+}
+
+void IndexedHeap::siftUp(int slot)
+{
+	const int index = _heap[slot];
+	while(slot > 0)
+	{
+		const int parent = (slot - 1) / 2;
+		if(!before(index, _heap[parent]))
+			break;
+		place(slot, _heap[parent]);
+		slot = parent;
+	}
+	place(slot, index);
+}
+
+void IndexedHeap::siftDown(int slot)
+{
+	const int index = _heap[slot];
+	const int size = static_cast<int>(_heap.size());
+	for(int child = slot * 2 + 1; child < size; child = slot * 2 + 1)
+	{
+		if(child + 1 < size && before(_heap[child + 1], _heap[child]))
+			++child;
+		if(!before(_heap[child], index))
+			break;
+		place(slot, _heap[child]);
+		slot = child;
+	}
+	place(slot, index);
+}
+
+void IndexedHeap::update(int index, float priority)
+{
+	assert(0 <= index && index < static_cast<int>(_slot.size()));
+	const float old_priority = _priority[index];
+	_priority[index] = priority;
+
+	int slot = _slot[index];
+	if(slot < 0)
+	{
+		slot = static_cast<int>(_heap.size());
+		_heap.push_back(index);
+		_slot[index] = slot;
+		siftUp(slot);
+	}
+	else if(priority > old_priority)
+		siftUp(slot);
+	else if(priority < old_priority)
+		siftDown(slot);
+}
+
+int IndexedHeap::pop()
+{
+	const int index = top();
+	remove(index);
+	return index;
+}
+
+void IndexedHeap::remove(int index)
+{
+	const int slot = _slot[index];
+	if(slot < 0)
+		return;
+
+	_slot[index] = -1;
+	const int last = _heap.back();
+	_heap.pop_back();
+	if(last == index)
+		return;
+
+	place(slot, last);
+	if(slot > 0 && before(last, _heap[(slot - 1) / 2]))
+		siftUp(slot);
+	else
+		siftDown(slot);
+}
+
 void Inpainter::initialize()
 {
 	CV_Assert(_input.image.channels() == 3 && _input.image.depth() == CV_8U &&
@@ -365,19 +523,55 @@ void Inpainter::initialize()
 	_tmc.setTemplateSize(cv::Size(_halfMatchSize * 2 + 1, _halfMatchSize * 2 + 1));
 	_tmc.setPartitionSize(cv::Size(3,3));
 	_tmc.initialize();
+
+	// Build the whole fill front once, later steps only update it around the patch just filled.
+	_borderRegion.create(_targetRegion.size());
+	_borderGradX.create(_targetRegion.size());
+	_borderGradY.create(_targetRegion.size());
+	_offsets.create(_targetRegion.size());
+	_offsets.setTo(cv::Scalar::all(0));
+	_fillFront.reset(_targetRegion.rows * _targetRegion.cols);
+	_remaining = cv::countNonZero(_targetRegion);
+	updateFillFront(cv::Rect(0, 0, _targetRegion.cols, _targetRegion.rows));
 }
 
 bool Inpainter::hasMoreSteps() const
 {
-	return cv::countNonZero(_targetRegion) > 0;
+	return _remaining > 0 && !_fillFront.empty();
 }
 
 void Inpainter::step()
 {	
-	// We also need an updated knowledge of gradients in the border region
-	updateFillFront();
-	
-	// Next, we need to select the best target patch on the boundary to be inpainted.
+	const int h = _halfPatchSize;
+	if(_input.search == Search::PATCHMATCH)
+	{
+		// Targets are apart, so that searching or filling one doesn't change what the others see.
+		const std::vector<cv::Point> targets = findTargetPatchLocations(16);
+		const int count = static_cast<int>(targets.size());
+		std::vector<cv::Point> sources(count);
+
+		#pragma omp parallel for
+		for(int i = 0; i < count; ++i)
+			sources[i] = searchSourcePatchLocation(targets[i]);
+
+		// Rarely random search misses all valid locations, fall back to exhaustive search which is not thread safe.
+		for(int i = 0; i < count; ++i)
+			if(sources[i].x == -1)
+			{
+				sources[i] = findSourcePatchLocation(targets[i], true);
+				if(sources[i].x == -1)
+					sources[i] = findSourcePatchLocation(targets[i], false);
+			}
+
+		for(int i = 0; i < count; ++i)
+			propagatePatch(targets[i], sources[i]);
+
+		for(const cv::Point& target: targets)
+			updateFillFront(cv::Rect(target.x - h, target.y - h, 2*h + 1, 2*h + 1));
+		return;
+	}
+
+	// Select the best target patch on the boundary to be inpainted.
 	cv::Point targetPatchLocation = findTargetPatchLocation();
 
 	// Determine the best matching source patch from which to inpaint.
@@ -387,78 +581,175 @@ void Inpainter::step()
 
 	// Copy values
 	propagatePatch(targetPatchLocation, sourcePatchLocation);
+
+	// We also need an updated knowledge of gradients in the border region, but only near the filled patch.
+	updateFillFront(cv::Rect(targetPatchLocation.x - h, targetPatchLocation.y - h, 2*h + 1, 2*h + 1));
 }
 
-void Inpainter::updateFillFront()
+void Inpainter::updateFillFront(const cv::Rect& rect)
 {
+	const cv::Rect bounds(0, 0, _targetRegion.cols, _targetRegion.rows);
+
+	// 3x3 kernels below see a change within 1 pixel. Filtering a ROI reads its neighbors from the whole image,
+	// so it produces the same result as filtering the whole image then cropping.
+	cv::Rect border_rect(rect.x - 1, rect.y - 1, rect.width + 2, rect.height + 2);
+	border_rect &= bounds;
+	if(border_rect.area() <= 0)
+		return;
+
+	const cv::Mat1b target = _targetRegion(border_rect);
+	cv::Mat1b border = _borderRegion(border_rect);
+	cv::Mat1f grad_x = _borderGradX(border_rect), grad_y = _borderGradY(border_rect);
+
 	// 2nd order derivative used to find border.
-	cv::Laplacian(_targetRegion, _borderRegion, CV_8U, 3, 1, 0, cv::BORDER_REPLICATE);
+	cv::Laplacian(target, border, CV_8U, 3, 1, 0, cv::BORDER_REPLICATE);
+	cv::Sobel(target, grad_x, CV_32F, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+	cv::Sobel(target, grad_y, CV_32F, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
 
-	// Update confidence values along fill front.
-	for(int y = _startY; y < _endY; ++y)
+	// Confidence of a pixel averages its patch, so it sees a change within half patch size.
+	const int margin = _halfPatchSize + 1;
+	cv::Rect update_rect(rect.x - margin, rect.y - margin, rect.width + 2*margin, rect.height + 2*margin);
+	update_rect &= cv::Rect(_startX, _startY, _endX - _startX, _endY - _startY);
+
+	// Update confidence and priority along fill front.
+	for(int y = update_rect.y; y < update_rect.y + update_rect.height; ++y)
 	{
 		const uchar *bRow = _borderRegion.ptr(y);
-		for(int x = _startX; x < _endX; ++x)
+		for(int x = update_rect.x; x < update_rect.x + update_rect.width; ++x)
 		{
+			const int index = y * _targetRegion.cols + x;
 			if(bRow[x] > 0)
 			{
 				// Update confidence for border item
 				cv::Point p(x, y);
 				_confidence(p) = confidenceForPatchLocation(p);
+				_fillFront.update(index, priorityForPatchLocation(p));
 			}
+			else
+				_fillFront.remove(index);
 		}
 	}
 }
 
-cv::Point Inpainter::findTargetPatchLocation()
+float Inpainter::priorityForPatchLocation(const cv::Point& point) const
 {
-	// Sweep over all pixels in the border region and priorize them based on 
-	// a confidence term (i.e how many pixels are already known) and a data term that prefers
-	// border pixels on strong edges running through them.
+	// Priorize border pixels based on a confidence term (i.e how many pixels are already known)
+	// and a data term that prefers border pixels on strong edges running through them.
 
-	float maxPriority = 0;
-	cv::Point bestLocation(0, 0);
+	// Data term
+	cv::Vec2f grad(_borderGradX(point), _borderGradY(point));
+	float dot = grad.dot(grad);
 
-	_borderGradX.create(_targetRegion.size());
-	_borderGradY.create(_targetRegion.size());
-	cv::Sobel(_targetRegion, _borderGradX, CV_32F, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
-	cv::Sobel(_targetRegion, _borderGradY, CV_32F, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+	if(dot == 0)
+		grad *= 0;
+	else
+		grad /= std::sqrt(dot);
 
-	for(int y = _startY; y < _endY; ++y)
+	const float d = std::abs(grad[0] * _isophoteX(point) + grad[1] * _isophoteY(point)) + 0.0001F;
+
+	// Confidence term
+	const float c = _confidence(point);
+
+	// Priority of patch
+	return c * d;
+}
+
+cv::Point Inpainter::findTargetPatchLocation() const
+{
+	const int index = _fillFront.top();
+	return cv::Point(index % _targetRegion.cols, index / _targetRegion.cols);
+}
+
+std::vector<cv::Point> Inpainter::findTargetPatchLocations(int count)
+{
+	// A target's match patch must not overlap the patch filled at another target.
+	const int distance = _halfMatchSize + _halfPatchSize;
+	constexpr int MAX_POP = 64;
+
+	std::vector<cv::Point> targets;
+	std::vector<int> popped;
+	while(static_cast<int>(targets.size()) < count && static_cast<int>(popped.size()) < MAX_POP && !_fillFront.empty())
 	{
-		const uchar *bRow  = _borderRegion.ptr(y);
-		const float *gxRow = _borderGradX.ptr<float>(y);
-		const float *gyRow = _borderGradY.ptr<float>(y);
-		const float *ixRow = _isophoteX.ptr<float>(y);
-		const float *iyRow = _isophoteY.ptr<float>(y);
-		const float *cRow  = _confidence.ptr<float>(y);
-
-		for(int x = _startX; x < _endX; ++x)
-		{
-			if(bRow[x] > 0)
+		const int index = _fillFront.top();
+		const cv::Point point(index % _targetRegion.cols, index / _targetRegion.cols);
+		popped.push_back(_fillFront.pop());
+
+		bool apart = true;
+		for(const cv::Point& target: targets)
+			if(std::abs(point.x - target.x) <= distance && std::abs(point.y - target.y) <= distance)
 			{
-				// Data term
-				cv::Vec2f grad(gxRow[x], gyRow[x]);
-				float dot = grad.dot(grad);
-
-				if(dot == 0)
-					grad *= 0;
-				else
-					grad /= std::sqrt(dot);
-		
-				const float d = std::abs(grad[0] * ixRow[x] + grad[1] * iyRow[x]) + 0.0001F;
+				apart = false;
+				break;
+			}
 
-				// Confidence term
-				const float c = cRow[x];
+		if(apart)
+			targets.push_back(point);
+	}
 
-				// Priority of patch
-				const float prio = c * d;
-				if(prio > maxPriority)
-				{
-					maxPriority = prio;
-					bestLocation = cv::Point(x,y);
-				}
-			}
+	// Put them all back, updateFillFront() will drop the ones no longer on the fill front.
+	for(const int index: popped)
+		_fillFront.update(index, _fillFront.priority(index));
+
+	return targets;
+}
+
+cv::Point Inpainter::searchSourcePatchLocation(const cv::Point& targetPatchLocation) const
+{
+	const int h = _halfMatchSize;
+	const cv::Point& t = targetPatchLocation;
+
+	cv::Mat3b targetImagePatch = centeredPatch<PATCHFLAGS>(_image, t.y, t.x, h);
+	cv::Mat1b targetMask = centeredPatch<PATCHFLAGS>(_targetRegion, t.y, t.x, h);
+	cv::Mat invTargetMask = (targetMask == 0);
+
+	cv::Point bestLocation(-1, -1);
+	float bestError = std::numeric_limits<float>::max();
+
+	auto test = [&](const cv::Point& p)
+	{
+		if(p.x < _startX || p.x >= _endX || p.y < _startY || p.y >= _endY || _sourceRegion(p) == 0)
+			return;
+
+		cv::Mat3b sourceImagePatch = centeredPatch<PATCHFLAGS>(_image, p.y, p.x, h);
+		float error = (float)cv::norm(targetImagePatch, sourceImagePatch, cv::NORM_L1, invTargetMask);
+		if(error < bestError)
+		{
+			bestError = error;
+			bestLocation = p;
+		}
+	};
+
+	// Propagation, neighbors filled from the same place usually share an offset, so test each one once.
+	std::vector<cv::Point> offsets;
+	cv::Mat2i offsetPatch = centeredPatch<PATCHFLAGS>(_offsets, t.y, t.x, h);
+	for(int y = 0; y < offsetPatch.rows; ++y)
+	for(int x = 0; x < offsetPatch.cols; ++x)
+	{
+		const cv::Vec2i& v = offsetPatch(y, x);
+		const cv::Point offset(v[0], v[1]);
+		if(offset != cv::Point(0, 0) && std::find(offsets.begin(), offsets.end(), offset) == offsets.end())
+		{
+			offsets.push_back(offset);
+			test(t + offset);
+		}
+	}
+
+	// Seeded by location, so that results don't depend on thread scheduling.
+	cv::RNG rng(static_cast<uint64>(t.y) * _image.cols + t.x + 1);
+
+	// Random initialization, more of it if there is nothing to propagate from.
+	const int samples = offsets.empty() ? 16 : 4;
+	for(int i = 0; i < samples; ++i)
+		test(cv::Point(rng.uniform(_startX, _endX), rng.uniform(_startY, _endY)));
+
+	// Random search around the best one, halving the window each time.
+	constexpr int ITERATIONS = 2;
+	for(int i = 0; i < ITERATIONS && bestLocation.x != -1; ++i)
+	{
+		for(int radius = std::max(_image.cols, _image.rows); radius >= 1; radius /= 2)
+		{
+			const cv::Point center = bestLocation;
+			test(cv::Point(center.x + rng.uniform(-radius, radius + 1), center.y + rng.uniform(-radius, radius + 1)));
 		}
 	}
 
@@ -525,8 +816,323 @@ void Inpainter::propagatePatch(const cv::Point& target, const cv::Point& source)
 
 	float cPatch = _confidence.at<float>(target);
 	centeredPatch<PATCHFLAGS>(_confidence, target.y, target.x, _halfPatchSize).setTo(cPatch, copyMask);
+
+	const cv::Point offset = source - target;
+	centeredPatch<PATCHFLAGS>(_offsets, target.y, target.x, _halfPatchSize).setTo(cv::Scalar(offset.x, offset.y), copyMask);
 	
+	_remaining -= cv::countNonZero(copyMask);
 	copyMask.setTo(0);
 }
 
-} /* namespace venus */
\ No newline at end of file
+/**
+ * For each vertical run of masked pixels in a column, mix the pixels mirrored about its upper and lower ends.
+ * Mirrored pixels are taken from the contiguous source pixels next to the run only.
+ */
+static void interpolate(cv::Mat& image, const cv::Mat& mask, const cv::Mat& source)
+{
+	const int rows = image.rows;
+	auto isSource = [&source](int r, int c) -> bool { return source.at<uint8_t>(r, c) != 0; };
+
+	#pragma omp parallel for
+	for(int c = 0; c < image.cols; ++c)
+	{
+		int r1 = 0;
+		while(r1 < rows)
+		{
+			int r0 = r1;
+			while(r0 < rows && mask.at<uint8_t>(r0, c) == 0)
+				++r0;
+			if(r0 >= rows)
+				break;
+
+			r1 = r0;
+			while(r1 < rows && mask.at<uint8_t>(r1, c) != 0)
+				++r1;
+
+			int top = r0, bottom = r1 - 1;  // bounds of source pixels above and below, inclusive
+			while(top > 0 && isSource(top - 1, c))
+				--top;
+			while(bottom + 1 < rows && isSource(bottom + 1, c))
+				++bottom;
+
+			const bool has_above = top < r0, has_below = bottom >= r1;
+			if(!has_above && !has_below)
+				continue;
+
+			const int length = r1 - r0;
+			for(int r = r0; r < r1; ++r)
+			{
+				const int above = has_above ? std::max(r0 * 2 - 1 - r, top) : std::min(r1 * 2 - 1 - r, bottom);
+				const int below = has_below ? std::min(r1 * 2 - 1 - r, bottom) : above;
+
+				float weight = (r - r0 + 0.5F) / length;
+				weight = smoothStep(0.42F, 0.78F, weight);  // prefer to use skin of eyes above than below.
+				image.at<cv::Vec3b>(r, c) = mix(image.at<cv::Vec3b>(above, c), image.at<cv::Vec3b>(below, c), weight);
+			}
+		}
+	}
+}
+
+/**
+ * Refine a rough fill of the target region, by searching a nearest neighbor field in the way of PatchMatch, then
+ * voting each pixel from all the source patches that cover it.
+ *
+ * @param[in,out] image          CV_8UC3 image, whose target region is already filled roughly.
+ * @param[in]     target         CV_8UC1 mask of pixels to refine.
+ * @param[in]     source         CV_8UC1 mask of pixels that can be copied from.
+ * @param[in,out] offsets        Source minus target location of each target pixel, as initial guess.
+ * @param[in]     halfPatchSize  Half the patch size.
+ * @param[in]     iterations     Rounds of search and vote.
+ */
+static void refine(cv::Mat3b& image, const cv::Mat1b& target, const cv::Mat1b& source, cv::Mat2i& offsets,
+		int halfPatchSize, int iterations)
+{
+	const int h = halfPatchSize;
+	const cv::Rect bounds(0, 0, image.cols, image.rows);
+
+	// A source patch must be inside image and source region as a whole.
+	cv::Mat1b valid = source & (target == 0);
+	cv::erode(valid, valid, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2*h + 1, 2*h + 1)),
+			cv::Point(-1, -1), 1, cv::BORDER_CONSTANT, cv::Scalar(0));
+	if(cv::countNonZero(valid) <= 0)
+		return;
+
+	std::vector<cv::Point> pixels;
+	cv::findNonZero(target, pixels);  // in raster order
+
+	auto isValid = [&](const cv::Point& q) { return bounds.contains(q) && valid(q) != 0; };
+	auto distance = [&](const cv::Point& p, const cv::Point& q)
+	{
+		std::pair<cv::Rect, cv::Rect> rects = comparablePatchRegions(image, image, p, q, h);
+		return (float)cv::norm(image(rects.first), image(rects.second), cv::NORM_L1);
+	};
+
+	cv::RNG rng(0x5EED);
+	const int length = static_cast<int>(pixels.size());
+	std::vector<float> errors(length);
+	for(int iteration = 0; iteration < iterations; ++iteration)
+	{
+		// Errors change with the image after each vote.
+		#pragma omp parallel for
+		for(int i = 0; i < length; ++i)
+		{
+			const cv::Point& p = pixels[i];
+			const cv::Vec2i& v = offsets(p);
+			const cv::Point q = p + cv::Point(v[0], v[1]);
+			errors[i] = isValid(q) ? distance(p, q) : std::numeric_limits<float>::max();
+		}
+
+		// Propagate from the neighbors visited before, alternating scan order as PatchMatch does.
+		const int step = (iteration % 2 == 0) ? 1 : -1;
+		for(int k = 0; k < length; ++k)
+		{
+			const int i = (step > 0) ? k : length - 1 - k;
+			const cv::Point& p = pixels[i];
+			cv::Vec2i& best = offsets(p);
+
+			auto test = [&](const cv::Point& offset)
+			{
+				const cv::Point q = p + offset;
+				if(!isValid(q))
+					return;
+
+				const float error = distance(p, q);
+				if(error < errors[i])
+				{
+					errors[i] = error;
+					best = cv::Vec2i(offset.x, offset.y);
+				}
+			};
+
+			const cv::Point neighbors[2] = { cv::Point(p.x - step, p.y), cv::Point(p.x, p.y - step) };
+			for(const cv::Point& neighbor: neighbors)
+				if(bounds.contains(neighbor) && target(neighbor) != 0)
+				{
+					const cv::Vec2i& v = offsets(neighbor);
+					test(cv::Point(v[0], v[1]));
+				}
+
+			// Random initialization for the ones still without a valid source.
+			for(int n = 0; n < 16 && errors[i] == std::numeric_limits<float>::max(); ++n)
+				test(cv::Point(rng.uniform(0, image.cols), rng.uniform(0, image.rows)) - p);
+
+			if(errors[i] == std::numeric_limits<float>::max())
+				continue;
+
+			for(int radius = std::max(image.cols, image.rows); radius >= 1; radius /= 2)
+				test(cv::Point(best[0] + rng.uniform(-radius, radius + 1), best[1] + rng.uniform(-radius, radius + 1)));
+		}
+
+		// Vote, every source patch covering a pixel contributes equally.
+		cv::Mat3b result = image.clone();
+		#pragma omp parallel for
+		for(int i = 0; i < length; ++i)
+		{
+			const cv::Point& p = pixels[i];
+			cv::Vec3i sum(0, 0, 0);
+			int count = 0;
+			for(int dy = -h; dy <= h; ++dy)
+			for(int dx = -h; dx <= h; ++dx)
+			{
+				const cv::Point neighbor(p.x + dx, p.y + dy);
+				if(!bounds.contains(neighbor) || target(neighbor) == 0)
+					continue;
+
+				const cv::Vec2i& v = offsets(neighbor);
+				if(!isValid(neighbor + cv::Point(v[0], v[1])))
+					continue;
+
+				const cv::Vec3b& color = image(p.y + v[1], p.x + v[0]);
+				sum += cv::Vec3i(color[0], color[1], color[2]);
+				++count;
+			}
+
+			if(count > 0)
+				result(p) = cv::Vec3b((sum[0] + count/2) / count, (sum[1] + count/2) / count, (sum[2] + count/2) / count);
+		}
+		image = result;
+	}
+}
+
+/**
+ * Coarse to fine inpainting. The coarsest level is filled by Inpainter, each finer level starts from the upsampled
+ * result and source offsets of the level below, and only refines them.
+ */
+static void inpaintPyramid(cv::Mat& image, const cv::Mat& mask, const cv::Mat& source, int radius)
+{
+	// Shrink until the hole is a few patches wide, while leaving enough room for source patches.
+	const cv::Rect rect = cv::boundingRect(mask);
+	int levels = 1;
+	while((std::max(rect.width, rect.height) >> (levels - 1)) > radius * 8 &&
+			(std::min(image.cols, image.rows) >> levels) >= radius * 12)
+		++levels;
+
+	std::vector<cv::Mat> images(levels), targets(levels), sources(levels);
+	images[0] = image;
+	targets[0] = (mask != 0);
+	sources[0] = (source != 0) & (mask == 0);
+	for(int l = 1; l < levels; ++l)
+	{
+		const cv::Size size((images[l - 1].cols + 1)/2, (images[l - 1].rows + 1)/2);
+		cv::resize(images[l - 1], images[l], size, 0, 0, cv::INTER_AREA);
+		cv::resize(targets[l - 1], targets[l], size, 0, 0, cv::INTER_AREA);
+		cv::resize(sources[l - 1], sources[l], size, 0, 0, cv::INTER_AREA);
+		targets[l] = (targets[l] > 0);     // partly covered pixels are to be filled
+		sources[l] = (sources[l] == 255) & (targets[l] == 0);  // only the fully known ones can be copied
+	}
+
+	Inpainter inpainter;
+	inpainter.setSourceImage(images[levels - 1]);
+	inpainter.setSourceMask(sources[levels - 1]);
+	inpainter.setTargetMask(targets[levels - 1]);
+	inpainter.setPatchSize(radius * 2);
+	inpainter.setSourceSearch(Inpainter::Search::PATCHMATCH);
+	inpainter.initialize();
+
+	while(inpainter.hasMoreSteps())
+		inpainter.step();
+
+	cv::Mat3b result = inpainter.image().clone();
+	cv::Mat2i offsets = inpainter.offsets().clone();
+
+	constexpr int ITERATIONS = 2;
+	for(int l = levels - 2; l >= 0; --l)
+	{
+		const cv::Size size = images[l].size();
+		cv::Mat upsampled;
+		cv::resize(result, upsampled, size, 0, 0, cv::INTER_LINEAR);
+		result = images[l].clone();
+		upsampled.copyTo(result, targets[l]);
+
+		cv::Mat2i upsampled_offsets;
+		cv::resize(offsets, upsampled_offsets, size, 0, 0, cv::INTER_NEAREST);
+		offsets = upsampled_offsets * 2;
+
+		refine(result, targets[l], sources[l], offsets, radius, ITERATIONS);
+	}
+
+	result.copyTo(image, targets[0]);
+}
+
+void inpaint(cv::Mat& image, const cv::Mat& mask, InpaintMethod method, int radius, const cv::Mat& source/* = cv::Mat() */)
+{
+	assert(image.type() == CV_8UC3 && mask.type() == CV_8UC1 && image.size() == mask.size());
+	assert(source.empty() || (source.type() == CV_8UC1 && source.size() == mask.size()));
+	assert(radius > 0);
+
+	cv::Rect rect = cv::boundingRect(mask);
+	if(rect.area() <= 0)
+		return;
+
+	// Pad as far as the method reaches, Criminisi also needs room for the source patches to match.
+	switch(method)
+	{
+	case InpaintMethod::INTERPOLATION:
+		rect.y -= rect.height;
+		rect.height *= 3;
+		break;
+	case InpaintMethod::TELEA:
+		Region::inset(rect, -(radius + 1));
+		break;
+	case InpaintMethod::CRIMINISI:
+	case InpaintMethod::PATCHMATCH:
+		Region::inset(rect, -radius * 6);
+		break;
+	case InpaintMethod::PYRAMID:  // coarse levels need as much room in their own scale
+		Region::inset(rect, -(radius * 6 + std::max(rect.width, rect.height) / 2));
+		break;
+	default:
+		assert(false);
+		return;
+	}
+	rect &= cv::Rect(0, 0, image.cols, image.rows);
+
+	cv::Mat roi = image(rect), roi_mask = mask(rect);
+	cv::Mat roi_source;
+	if(source.empty())
+		cv::bitwise_not(roi_mask, roi_source);
+	else
+		roi_source = source(rect);
+
+	switch(method)
+	{
+	case InpaintMethod::INTERPOLATION:
+		interpolate(roi, roi_mask, roi_source);
+		break;
+
+	case InpaintMethod::TELEA:
+	{
+		// tested with Navier-Stokes algorithm and A. Telea algorithm, and no obvious difference found.
+		cv::Mat result;
+		cv::inpaint(roi, roi_mask, result, radius, cv::INPAINT_TELEA);
+		result.copyTo(roi);
+		break;
+	}
+
+	case InpaintMethod::CRIMINISI:
+	case InpaintMethod::PATCHMATCH:
+	{
+		Inpainter inpainter;
+		inpainter.setSourceImage(roi);
+		inpainter.setSourceMask(roi_source);
+		inpainter.setTargetMask(roi_mask);
+		inpainter.setPatchSize(radius * 2);
+		inpainter.setSourceSearch(method == InpaintMethod::PATCHMATCH ? Inpainter::Search::PATCHMATCH : Inpainter::Search::EXHAUSTIVE);
+		inpainter.initialize();
+
+		while(inpainter.hasMoreSteps())
+			inpainter.step();
+		inpainter.image().copyTo(roi);
+		break;
+	}
+
+	case InpaintMethod::PYRAMID:
+		inpaintPyramid(roi, roi_mask, roi_source, radius);
+		break;
+
+	default:
+		break;
+	}
+}
+
+} /* namespace venus */
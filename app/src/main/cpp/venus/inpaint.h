@@ -1,6 +1,8 @@
 #ifndef VENUS_INPAINT_H_
 #define VENUS_INPAINT_H_
 
+#include <vector>
+
 #include <opencv2/core.hpp>
 
 namespace venus {
@@ -32,10 +34,26 @@ namespace venus {
 			template. Only those areas are considered during classification. A block is rejected
 			from the decision process if not all its pixels are masked. If no mask is passed, all
 			blocks are considered valid.
+
+		- Blocks are flattened into arrays of offsets within the integral image, so that a few
+			adjacent template positions are evaluated at once with SIMD, and rows run in parallel.
 */
 class TemplateMatchCandidates
 {
 private:
+	/**
+	 * Corners of blocks as element offsets in an integral image, relative to the top-left corner of a template
+	 * position. Each corner is an array over blocks, so that a block reads 4 contiguous template positions.
+	 */
+	struct BlockOffsets
+	{
+		std::vector<int> topLeft, topRight, bottomLeft, bottomRight;
+		std::vector<float> area;
+
+		BlockOffsets(const std::vector<cv::Rect> &rects, size_t step);
+		int size() const { return static_cast<int>(area.size()); }
+	};
+
 	cv::Mat _image;
 	std::vector<cv::Mat1i> _integrals;
 	std::vector<cv::Rect>  _blocks;
@@ -53,8 +71,15 @@ private:
 	/** Calculate the weak classifiers for the template, taking the mask into account. */
 	void weakClassifiersForTemplate(const cv::Mat &templ, const cv::Mat &templMask, const std::vector<cv::Rect> &rects, cv::Mat1i &classifiers, cv::Scalar &mean);
 
-	/** Compare the template classifiers to the classifiers generated from the given template position. */
-	unsigned char compareWeakClassifiers(const cv::Mat1i &i, int x, int y, const cv::Size &templSize, const std::vector<cv::Rect> &blocks, const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors);
+	/**
+	 * Compare the template classifiers to the classifiers generated from the given template position.
+	 *
+	 * @param integral  Top-left corner of the template position in integral image.
+	 * @param templ     The whole template as a single block.
+	 * @param blocks    Blocks of the template.
+	 */
+	static unsigned char compareWeakClassifiers(const int *integral, const BlockOffsets &templ, const BlockOffsets &blocks,
+			const int *compareTo, float templateMean, float maxMeanDiff, int maxWeakErrors);
 
 public:
 	/** Set the source image. */
@@ -83,6 +108,45 @@ public:
 };
 
 
+/**
+ * Max-heap of pixel indices keyed by priority, a pixel's priority can be changed or the pixel removed in
+ * O(log n). Ties are broken by the smaller index, so that the top is the same as a raster scan would find.
+ */
+class IndexedHeap
+{
+private:
+	std::vector<int>   _heap;      ///< pixel indices
+	std::vector<int>   _slot;      ///< position of each pixel in _heap, -1 if absent
+	std::vector<float> _priority;  ///< priority of each pixel
+
+	bool before(int a, int b) const;
+	void place(int slot, int index);
+	void siftUp(int slot);
+	void siftDown(int slot);
+
+public:
+	/** Clear the heap, and set the range of pixel indices to [0, size). */
+	void reset(int size);
+
+	bool empty() const { return _heap.empty(); }
+	bool contains(int index) const { return _slot[index] >= 0; }
+
+	/** Pixel index of the highest priority, the heap must not be empty. */
+	int top() const { return _heap.front(); }
+
+	/** Remove and return the pixel index of the highest priority, the heap must not be empty. */
+	int pop();
+
+	/** Priority last given to the pixel. */
+	float priority(int index) const { return _priority[index]; }
+
+	/** Insert the pixel, or change its priority if it's already there. */
+	void update(int index, float priority);
+
+	/** Remove the pixel if it's there. */
+	void remove(int index);
+};
+
 /*
 	Implementation of the exemplar based inpainting algorithm described in
 	"Object Removal by Exemplar-Based Inpainting", A. Criminisi et. al. 
@@ -97,9 +161,26 @@ public:
 
 	Please note edge cases (i.e regions on the image border) are crudely handled by simply 
 	discarding them.
+
+	The fill front is kept in an IndexedHeap of priorities. After a patch is filled, only the fill front
+	within reach of that patch is updated, instead of sweeping the whole image every step.
+
+	Alternatively the source patch can be searched in the way of PatchMatch, see
+	"PatchMatch: A Randomized Correspondence Algorithm for Structural Image Editing", Connelly Barnes et. al.
+	Every filled pixel remembers the offset to where it was copied from. A target patch tries offsets of its
+	already filled neighbors, then refines the best one by random search at exponentially decreasing radius.
+	Patches on the fill front that are far enough apart are searched in parallel in one step.
 */
 class Inpainter
 {
+public:
+	/** How to search for the source patch of a target patch. */
+	enum class Search
+	{
+		EXHAUSTIVE,  ///< Test all candidates that pass TemplateMatchCandidates, finest but slowest.
+		PATCHMATCH,  ///< Propagate offsets from filled neighbors and refine them randomly.
+	};
+
 private:
 	struct UserSpecified
 	{
@@ -107,9 +188,11 @@ private:
 		cv::Mat sourceMask;
 		cv::Mat targetMask;
 		int patchSize;
+		Search search;
 
 		UserSpecified():
-				patchSize(9)
+				patchSize(9),
+				search(Search::EXHAUSTIVE)
 		{
 		}
 	};
@@ -120,20 +203,42 @@ private:
 	cv::Mat _image, _candidates;
 	cv::Mat1b _targetRegion, _borderRegion, _sourceRegion;
 	cv::Mat1f _isophoteX, _isophoteY, _confidence, _borderGradX, _borderGradY;
+	cv::Mat2i _offsets;  ///< source minus target location of filled pixels, (0, 0) if none
 	int _halfPatchSize, _halfMatchSize;
 	int _startX, _startY, _endX, _endY;
 
+	IndexedHeap _fillFront;
+	int _remaining;  ///< count of pixels to be filled
+
 private:
 
-	/** Updates the fill-front which is the border between filled and unfilled regions. */
-	void updateFillFront();
+	/**
+	 * Updates the fill-front which is the border between filled and unfilled regions, along with confidence and
+	 * priority of the fill front pixels. Only pixels that can be affected by a change of target region inside
+	 * @p rect are visited.
+	 */
+	void updateFillFront(const cv::Rect& rect);
+
+	/** Priority of a pixel on the fill front, @see updateFillFront() */
+	float priorityForPatchLocation(const cv::Point& point) const;
 
 	/** Find patch on fill front with highest priortiy. This will be the patch to be inpainted in this step. */
-	cv::Point findTargetPatchLocation();
+	cv::Point findTargetPatchLocation() const;
 
 	/** For a given patch to inpaint, search for the best matching source patch to use for inpainting. */
 	cv::Point findSourcePatchLocation(const cv::Point& targetPatchLocation, bool useCandidateFilter);
 
+	/**
+	 * Search the source patch in the way of PatchMatch, it only reads the state so that patches which don't
+	 * overlap can be searched in parallel.
+	 *
+	 * @return The source location, or (-1, -1) if no valid one has been hit.
+	 */
+	cv::Point searchSourcePatchLocation(const cv::Point& targetPatchLocation) const;
+
+	/** Pick up to @p count targets from the top of the fill front, whose match patches don't overlap patches to be filled. */
+	std::vector<cv::Point> findTargetPatchLocations(int count);
+
 	/** Calculate the confidence for the given patch location. */
 	float confidenceForPatchLocation(const cv::Point& point) const;
 	
@@ -157,13 +262,16 @@ public:
 	/** Set the patch size. */
 	inline void setPatchSize(int size) { _input.patchSize = size; }
 
+	/** Set how to search for source patches, default to Search::EXHAUSTIVE. */
+	inline void setSourceSearch(Search search) { _input.search = search; }
+
 	/** Initialize inpainting. */
 	void initialize();
 
 	/** True if there are more steps to perform. */
 	bool hasMoreSteps() const;
 
-	/** Perform a single step (i.e fill one patch) and return the updated information. */
+	/** Perform a single step (i.e fill one patch, or a few far apart ones with Search::PATCHMATCH) and return the updated information. */
 	void step();
 
 	/** Access the current state of the inpainted image. */
@@ -171,7 +279,36 @@ public:
 
 	/** Access the current state of the target region. */
 	const cv::Mat& targetRegion() const { return _targetRegion; }
+
+	/** Access the offsets from filled pixels to where they were copied from, (0, 0) for the others. */
+	const cv::Mat2i& offsets() const { return _offsets; }
+};
+
+/**
+ * Inpainting algorithms, roughly from the fastest to the finest, so that a quick preview and the final export
+ * can pick different ones at runtime.
+ */
+enum class InpaintMethod
+{
+	INTERPOLATION,  ///< Interpolate each column between pixels mirrored above and below, the ones above are preferred. It fits thin horizontal shapes like brows.
+	TELEA,          ///< cv::inpaint() with cv::INPAINT_TELEA, "An Image Inpainting Technique Based on the Fast Marching Method", Alexandru Telea.
+	CRIMINISI,      ///< Exemplar based, @see Inpainter
+	PATCHMATCH,     ///< Exemplar based with randomized source search, @see Inpainter::Search::PATCHMATCH
+	PYRAMID,        ///< PATCHMATCH on a downsampled image, then refined level by level up to the original size. It fits large holes.
 };
 
+/**
+ * Fill pixels under @p mask in place. Whichever method is used, it only works on the bounding rectangle of
+ * @p mask padded as much as the method needs to reach the surrounding pixels, the rest of @p image is never read.
+ *
+ * @param[in,out] image   CV_8UC3 image.
+ * @param[in]     mask    CV_8UC1 mask of the same size, nonzero pixels are to be filled.
+ * @param[in]     method  The algorithm.
+ * @param[in]     radius  Neighborhood radius of TELEA, and half the patch size of the exemplar based ones.
+ * @param[in]     source  Optional CV_8UC1 mask of pixels that can be copied from, default to pixels not in @p mask.
+ *                        It's used by all but TELEA.
+ */
+void inpaint(cv::Mat& image, const cv::Mat& mask, InpaintMethod method, int radius, const cv::Mat& source = cv::Mat());
+
 } /* namespace venus */
 #endif /* VENUS_INPAINT_H_ */
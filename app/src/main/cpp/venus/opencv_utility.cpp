@@ -1,6 +1,8 @@
 #include "venus/opencv_utility.h"
 #include "venus/scalar.h"
 
+#include <cstring>
+
 #include <opencv2/imgproc.hpp>
 
 using namespace cv;
@@ -231,6 +233,49 @@ cv::Mat splitAlpha(const cv::Mat& image)
 	return mask;
 }
 
+uint64_t fingerprint(const void* data, size_t length, uint64_t seed/* = 14695981039346656037ULL */)
+{
+	constexpr uint64_t fnv_prime = 1099511628211ULL;
+	uint64_t state = seed;
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+	const uint8_t* end = p + length;
+
+	// 8 bytes a step, multiplication only carries upward, so fold high bits back to keep every bit mixed.
+	for(; p + sizeof(uint64_t) <= end; p += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, p, sizeof(word));  // unaligned load
+		state = (state ^ word) * fnv_prime;
+		state ^= state >> 32;
+	}
+
+	for(; p < end; ++p)
+		state = (state ^ *p) * fnv_prime;
+
+	// finalizer of MurmurHash3, so that a change of any byte reaches every bit of the result.
+	state ^= state >> 33;
+	state *= 0xFF51AFD7ED558CCDULL;
+	state ^= state >> 33;
+	state *= 0xC4CEB9FE1A85EC53ULL;
+	state ^= state >> 33;
+	return state;
+}
+
+uint64_t fingerprint(const cv::Mat& mat, uint64_t seed/* = 14695981039346656037ULL */)
+{
+	const int header[3] = { mat.rows, mat.cols, mat.type() };
+	uint64_t state = fingerprint(header, sizeof(header), seed);
+
+	if(mat.isContinuous())
+		return fingerprint(mat.data, mat.total() * mat.elemSize(), state);
+
+	const size_t row_size = mat.cols * mat.elemSize();
+	for(int r = 0; r < mat.rows; ++r)
+		state = fingerprint(mat.ptr<uint8_t>(r), row_size, state);
+
+	return state;
+}
+
 cv::Mat normalize(const cv::Mat& mat, double* max/* = nullptr */)
 {
 	double x = 1.0;
@@ -159,6 +159,15 @@ cv::Mat splitAlpha(const cv::Mat& image);
 
 cv::Mat normalize(const cv::Mat& mat, double* max = nullptr);
 
+/**@{
+ * 64 bits FNV-1a like hash that eats 8 bytes a step, chain calls by passing the previous result as @p seed. It's
+ * a cache key, not for persistence. The cv::Mat version takes size and type into account, and works on
+ * submatrices too.
+ */
+uint64_t fingerprint(const void* data, size_t length, uint64_t seed = 14695981039346656037ULL);
+uint64_t fingerprint(const cv::Mat& mat, uint64_t seed = 14695981039346656037ULL);
+/**@}*/
+
 /**
  * like cv::line() but draw line that run through whole image, not line segment between pt0 and pt1
  */